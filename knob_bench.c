@@ -0,0 +1,209 @@
+#include <cairo.h>
+#include <math.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// gcc -O2 -g knob_bench.c -lm -lpthread -lz `pkg-config --cflags --libs cairo` -o knobbench
+
+#include "strip.h"
+#include "knob_draw.h"
+#include "switch_draw.h"
+
+/** benchmark the knob and switch strips, sweep sizes and frame counts,
+ *  render each strip with strip_render() like knobmake does, on one thread
+ *  and on the -j threads, and report the time spent per stage as json.
+ *  The strips are laid out in the near square grid, like knobmake -c 0,
+ *  so the large ones stay below the surface limit. There is no compositing
+ *  stage, image strips draw each frame in place, the png encoding is timed
+ *  instead **/
+
+typedef enum {
+	ST_BODY,
+	ST_GEARS,
+	ST_POINTER,
+	ST_RING,
+	ST_SHADING,
+	ST_PAINT,
+	ST_PNG,
+	ST_COUNT,
+} stage;
+
+static const char *stage_names[ST_COUNT] = {
+	"body", "gears", "pointer", "ring", "shading", "paint", "png"
+};
+
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// png encoder sink, count the bytes but don't touch the disk
+static cairo_status_t png_count(void *closure, const unsigned char *data, unsigned int length) {
+	(void)data;
+	*(size_t*)closure += length;
+	return CAIRO_STATUS_SUCCESS;
+}
+
+// time one knob frame stage by stage, like paint_knob_state() does
+static void bench_knob_frame(cairo_t *cr, const knob_geometry *g, double knobstate, double *t) {
+	double angle = scale_zero + knobstate * 2 * (M_PI - scale_zero);
+	double s = now(), e;
+	paint_knob_base(cr, g);
+	e = now(); t[ST_BODY] += e - s; s = e;
+	paint_knob_gears(cr, g, angle);
+	e = now(); t[ST_GEARS] += e - s; s = e;
+	paint_knob_pointer(cr, g, angle);
+	e = now(); t[ST_POINTER] += e - s; s = e;
+	draw_indicator_ring(cr, knobstate, g->radius, angle, g->knobx1+g->arc_offset/2, g->knoby1+g->arc_offset/2);
+	e = now(); t[ST_RING] += e - s; s = e;
+	paint_knob_overlay(cr, g);
+	e = now(); t[ST_SHADING] += e - s;
+}
+
+// the stage times of the serial run, the paint functions add to it
+static double stage_time[ST_COUNT];
+
+static void bench_paint_knob(cairo_t *cr, int knob_size, int knob_offset, double knobstate) {
+	knob_geometry g;
+	knob_geometry_init(&g, knob_size, knob_offset);
+	bench_knob_frame(cr, &g, knobstate, stage_time);
+	knob_geometry_release(&g);
+}
+
+static void bench_paint_switch(cairo_t *cr, int knob_size, int knob_offset, double knobstate) {
+	double s = now();
+	paint_switch_state(cr, knob_size, knob_offset, knobstate);
+	stage_time[ST_PAINT] += now() - s;
+}
+
+// render the strip with strip_render(), returns the seconds it takes, the strip stay in img
+static double bench_render(cairo_surface_t *img, paint_func paint, const strip_meta *layout,
+						   const strip_options *o) {
+	cairo_t *cr = cairo_create(img);
+	// strip_render draw in place, so the strip need to be clear
+	cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+	cairo_paint(cr);
+	cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+	double s = now();
+	strip_render(cr, paint, layout, 0, o);
+	double e = now() - s;
+	cairo_destroy(cr);
+	return e;
+}
+
+/** render one strip repeats times and write the timing as json object,
+ *  the stages come from the serial run, the threaded run use the plain paint function **/
+static int bench_strip(FILE *out, int first, const char *type, int knob_size, int knob_frames, int repeats,
+						const strip_options *o) {
+	int knob = strcmp(type, "knob") == 0;
+	memset(stage_time, 0, sizeof(stage_time));
+	size_t png_size = 0;
+	strip_meta layout;
+	strip_meta_init(&layout, knob_size, knob_frames);
+	strip_meta_layout(&layout, 0);
+	strip_options serial = *o;
+	serial.threads = 1;
+
+	cairo_surface_t *knob_img = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+							knob_size * layout.columns, knob_size * layout.rows);
+	if (cairo_surface_status(knob_img) != CAIRO_STATUS_SUCCESS) {
+		fprintf(stderr, "%-6s %4i px %4i frames: skipped, could not create the %ix%i strip\n",
+				type, knob_size, knob_frames, knob_size * layout.columns, knob_size * layout.rows);
+		cairo_surface_destroy(knob_img);
+		return 1;
+	}
+	double render = 0.0;
+	double threaded = 0.0;
+	for (int r = 0; r < repeats; r++) {
+		render += bench_render(knob_img, knob ? bench_paint_knob : bench_paint_switch, &layout, &serial);
+		threaded += bench_render(knob_img, knob ? paint_knob_state : paint_switch_state, &layout, o);
+		cairo_surface_flush(knob_img);
+		png_size = 0;
+		double s = now();
+		cairo_surface_write_to_png_stream(knob_img, png_count, &png_size);
+		stage_time[ST_PNG] += now() - s;
+	}
+	cairo_surface_destroy(knob_img);
+
+	double frames = (double)knob_frames * repeats;
+	fprintf(out, "%s\n    {\"type\": \"%s\", \"size\": %i, \"frames\": %i, \"columns\": %i, \"rows\": %i, \"repeats\": %i,\n"
+				 "     \"frames_per_s\": %.2f, \"ms_per_frame\": %.4f, \"threads\": %i, \"threaded_frames_per_s\": %.2f,\n"
+				 "     \"png_ms\": %.3f, \"png_bytes\": %zu,\n"
+				 "     \"stages_ms_per_frame\": {",
+			first ? "" : ",", type, knob_size, knob_frames, layout.columns, layout.rows, repeats,
+			render > 0.0 ? frames / render : 0.0, render * 1e3 / frames,
+			o->threads, threaded > 0.0 ? frames / threaded : 0.0,
+			stage_time[ST_PNG] * 1e3 / repeats, png_size);
+	int n = 0;
+	for (int s = 0; s < ST_COUNT; s++) {
+		if (stage_time[s] == 0.0) continue;
+		fprintf(out, "%s\"%s\": %.4f", n++ ? ", " : "", stage_names[s], stage_time[s] * 1e3 / frames);
+	}
+	fprintf(out, "}}");
+	fprintf(stderr, "%-6s %4i px %4i frames: %9.2f frames/s %8.4f ms/frame, %i threads %9.2f frames/s\n",
+			type, knob_size, knob_frames, render > 0.0 ? frames / render : 0.0, render * 1e3 / frames,
+			o->threads, threaded > 0.0 ? frames / threaded : 0.0);
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	static const int sizes[] = {32, 64, 128, 256, 512};
+	static const int frames[] = {2, 31, 101, 257};
+	static const char *types[] = {"knob", "switch"};
+	const char *json_file = NULL;
+	int repeats = 1;
+	strip_options o;
+	strip_options_init(&o);
+	o.formats = STRIP_PNG;
+	o.threads = strip_cpu_count();
+	int opt;
+	while ((opt = getopt(argc, argv, "o:r:j:")) != -1) {
+		switch (opt) {
+			case 'o':
+				// write the json to a file instead of stdout
+				json_file = optarg;
+			break;
+			case 'r':
+				// render every strip N times
+				repeats = max(1, atoi(optarg));
+			break;
+			case 'j':
+				// threads for the threaded run, 0 use all cpu's
+				strip_parse_option(&o, opt, optarg);
+			break;
+			default:
+				fprintf(stdout, "usage: %s [-o results.json] [-r repeats] [-j threads]\n", basename(argv[0]));
+				return 1;
+		}
+	}
+
+	FILE *out = json_file ? fopen(json_file, "w") : stdout;
+	if (!out) {
+		fprintf(stderr, "could not open %s\n", json_file);
+		return 1;
+	}
+
+	fprintf(out, "{\n  \"cairo\": \"%s\",\n  \"layout\": \"grid\",\n"
+				 "  \"note\": \"no composite stage, image strips draw the frames in place, png is the encoding\",\n"
+				 "  \"results\": [", cairo_version_string());
+	int first = 1;
+	for (unsigned t = 0; t < sizeof(types)/sizeof(types[0]); t++) {
+		for (unsigned s = 0; s < sizeof(sizes)/sizeof(sizes[0]); s++) {
+			for (unsigned f = 0; f < sizeof(frames)/sizeof(frames[0]); f++) {
+				if (!bench_strip(out, first, types[t], sizes[s], frames[f], repeats, &o)) first = 0;
+			}
+		}
+	}
+	fprintf(out, "\n  ]\n}\n");
+	knob_shapes_clear();
+	switch_patterns_clear();
+
+	if (out != stdout) fclose(out);
+	return 0;
+}
@@ -0,0 +1,605 @@
+#ifndef KNOB_DRAW_H
+#define KNOB_DRAW_H
+
+#include <cairo.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include "knob_trace.h"
+
+// the knob drawing, edit this to create a new knob
+
+#ifndef min
+#define min(x, y) ((x) < (y) ? (x) : (y))
+#endif
+#ifndef max
+#define max(x, y) ((x) < (y) ? (y) : (x))
+#endif
+
+static const double scale_zero = 20 * (M_PI/180); // defines "dead zone" for knobs
+
+// the indicator ring, knob_rotate.h pass these on to knobview -r
+static const double ring_dashes[] = {4.0, 6.0};
+static const double ring_width = 4.0;
+static const double ring_sweep = 320 * (M_PI/180);
+static const double ring_background[3] = {0.2, 0.2, 0.2};
+static const double ring_foreground[3] = {0.2, 0.5, 0.2};
+
+/** color roles for knobmake -m, in the order they are drawn. Each role
+ *  is rendered on its own as a coverage mask, knobtheme give them new colors
+ *  and composite them in this order. Set the colors with knob_role_source()
+ *  and knob_role_pattern(), so a new knob keep working with themes **/
+enum {
+	KNOB_ROLE_BODY,
+	KNOB_ROLE_BORDER,
+	KNOB_ROLE_GEAR,
+	KNOB_ROLE_GEAR_EDGE,
+	KNOB_ROLE_HUB,
+	KNOB_ROLE_POINTER,
+	KNOB_ROLE_POINTER_EDGE,
+	KNOB_ROLE_RING_BACKGROUND,
+	KNOB_ROLE_RING_FOREGROUND,
+	KNOB_ROLE_INNER,
+	KNOB_ROLE_INNER_EDGE,
+	KNOB_ROLES,
+	// the 3d shading isn't recolored, it's kept as ARGB32 on top of the roles
+	KNOB_ROLE_SHADE = KNOB_ROLES,
+};
+
+static const char *const knob_role_names[KNOB_ROLES + 1] = {
+	"body", "border", "gear", "gear_edge", "hub", "pointer", "pointer_edge",
+	"ring_background", "ring_foreground", "inner", "inner_edge", "shade",
+};
+
+// the role drawn by the mask render, -1 draw the knob as usual
+static int knob_mask_role = -1;
+// the colors the roles are drawn with, filled by the mask render
+static double knob_role_colors[KNOB_ROLES][4];
+static pthread_mutex_t role_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static inline void knob_role_store(int role, double r, double g, double b, double a) {
+	pthread_mutex_lock(&role_lock);
+	knob_role_colors[role][0] = r;
+	knob_role_colors[role][1] = g;
+	knob_role_colors[role][2] = b;
+	knob_role_colors[role][3] = a;
+	pthread_mutex_unlock(&role_lock);
+}
+
+/** set the color of a role, in mask mode only the role which is rendered
+ *  is drawn, in opaque white, all others are drawn transparent **/
+static inline void knob_role_source(cairo_t *cr, int role, double r, double g, double b, double a) {
+	if (knob_mask_role < 0) {
+		cairo_set_source_rgba(cr, r, g, b, a);
+	} else if (role == knob_mask_role) {
+		knob_role_store(role, r, g, b, 1.0);
+		cairo_set_source_rgba(cr, 1.0, 1.0, 1.0, a);
+	} else {
+		cairo_set_source_rgba(cr, 0.0, 0.0, 0.0, 0.0);
+	}
+}
+
+// a gradient role, its mask is flat and the theme color default to the mean of the stops
+static inline void knob_role_pattern(cairo_t *cr, int role, cairo_pattern_t *pat) {
+	if (knob_mask_role < 0 || (role == KNOB_ROLE_SHADE && knob_mask_role == KNOB_ROLE_SHADE)) {
+		cairo_set_source(cr, pat);
+	} else if (role == knob_mask_role) {
+		double mean[4] = {0.0, 0.0, 0.0, 0.0};
+		double c[4], offset;
+		int count = 0;
+		cairo_pattern_get_color_stop_count(pat, &count);
+		for (int i = 0; i < count; i++) {
+			cairo_pattern_get_color_stop_rgba(pat, i, &offset, &c[0], &c[1], &c[2], &c[3]);
+			for (int k = 0; k < 4; k++) mean[k] += c[k] / count;
+		}
+		knob_role_store(role, mean[0], mean[1], mean[2], 1.0);
+		cairo_set_source_rgba(cr, 1.0, 1.0, 1.0, count ? mean[3] : 1.0);
+	} else {
+		cairo_set_source_rgba(cr, 0.0, 0.0, 0.0, 0.0);
+	}
+}
+
+static inline void draw_indicator_ring_background(cairo_t *cr, double ind_radius,
+										   double x_center, double y_center) {
+
+	double add_angle = 90 * (M_PI / 180.);
+
+	cairo_set_dash(cr, ring_dashes, sizeof(ring_dashes)/sizeof(ring_dashes[0]), 0);
+
+	// draw background
+	knob_role_source(cr, KNOB_ROLE_RING_BACKGROUND, ring_background[0], ring_background[1], ring_background[2], 1.0);
+	cairo_set_line_width(cr, ring_width);
+	cairo_set_line_cap(cr, CAIRO_LINE_CAP_ROUND);
+	cairo_set_line_join(cr, CAIRO_LINE_JOIN_BEVEL);
+	cairo_arc (cr, x_center , y_center, ind_radius,
+		  add_angle + scale_zero, add_angle + scale_zero + ring_sweep);
+	cairo_stroke(cr);
+	cairo_set_dash(cr, NULL, 0, 0);
+}
+
+static inline void draw_indicator_ring_foreground(cairo_t *cr, double ind_radius,
+										   double angle, double x_center, double y_center) {
+
+	double add_angle = 90 * (M_PI / 180.);
+
+	// draw foreground
+	if (scale_zero < angle) {
+		cairo_set_dash(cr, ring_dashes, sizeof(ring_dashes)/sizeof(ring_dashes[0]), 0);
+		knob_role_source(cr, KNOB_ROLE_RING_FOREGROUND, ring_foreground[0], ring_foreground[1], ring_foreground[2], 1.0);
+		cairo_set_line_width(cr, ring_width);
+		cairo_set_line_cap(cr, CAIRO_LINE_CAP_ROUND);
+		cairo_set_line_join(cr, CAIRO_LINE_JOIN_BEVEL);
+		cairo_arc (cr, x_center, y_center, ind_radius,
+			  add_angle + scale_zero, add_angle + angle);
+		cairo_stroke(cr);
+		cairo_set_dash(cr, NULL, 0, 0);
+	}
+}
+
+static inline void draw_indicator_ring( cairo_t *cr, double knobstate, double ind_radius, 
+								 double angle, double x_center, double y_center) {
+	draw_indicator_ring_background(cr, ind_radius, x_center, y_center);
+	draw_indicator_ring_foreground(cr, ind_radius, angle, x_center, y_center);
+}
+
+static inline cairo_pattern_t *shading_pattern(int arc_offset, double knobx1, double knoby1, double knob_x) {
+	cairo_pattern_t* pat =
+		cairo_pattern_create_radial (knobx1+arc_offset-knob_x/6,knoby1+arc_offset-knob_x/6,
+									 1,knobx1+arc_offset,knoby1+arc_offset,knob_x/2.1 );
+	cairo_pattern_add_color_stop_rgba (pat, 1,  0.0, 0.0, 0.0, 0.6);
+	cairo_pattern_add_color_stop_rgba (pat, 0.3,  0.3, 0.3, 0.3, 0.6);
+	cairo_pattern_add_color_stop_rgba (pat, 0,  0.4, 0.4, 0.4, 0.6);
+	return pat;
+}
+
+// pat is the gradient of shading_pattern(), made once per size
+static inline void shading(cairo_t *cr, int arc_offset, double knobx1, double knoby1, double knob_x,
+					cairo_pattern_t *pat) {
+	cairo_arc(cr,knobx1+arc_offset/2, knoby1+arc_offset/2, knob_x/2.1, 0, 2 * M_PI );
+	knob_role_pattern(cr, KNOB_ROLE_SHADE, pat);
+	cairo_fill (cr);
+}
+
+static inline void inner_ring(cairo_t *cr, int arc_offset, double knobx1, double knoby1, double knob_x) {
+	cairo_arc(cr,knobx1+arc_offset/2, knoby1+arc_offset/2, knob_x/5.1, 0, 2 * M_PI );
+	cairo_pattern_t* pat = cairo_pattern_create_radial (knobx1+arc_offset/2, knoby1+arc_offset/2,
+											  1,knobx1+arc_offset,knoby1+arc_offset,knob_x/2.1 );
+	cairo_pattern_add_color_stop_rgba (pat, 0,  0.1, 0.1, 0.1, 1.0);
+	cairo_pattern_add_color_stop_rgba (pat, 1,  0.0, 0.0, 0.0, 1.0);
+	knob_role_pattern(cr, KNOB_ROLE_INNER, pat);
+	cairo_fill_preserve(cr);
+	knob_role_source(cr, KNOB_ROLE_INNER_EDGE, 0.05, 0.15, 0.05, 1.0); // knob pointer color
+	cairo_set_line_width(cr,4);
+	cairo_stroke(cr);
+	cairo_pattern_destroy (pat);
+}
+
+// the outline of a gear around 0,0, xy get 4 * teeth points
+static inline void gear_vertexes(double radius, int teeth, double tooth_depth, double *xy) {
+
+	int i;
+	double r1, r2;
+	double angle, da;
+
+	r1 = radius - tooth_depth / 2.0;
+	r2 = radius + tooth_depth / 2.0;
+
+	da = 2.0 * M_PI / (double) teeth / 4.0;
+
+	angle = 0.0;
+	*xy++ = r1 * cos (angle + 3 * da);
+	*xy++ = r1 * sin (angle + 3 * da);
+
+	for (i = 1; i <= teeth; i++) {
+		angle = i * 2.0 * M_PI / (double) teeth;
+
+		*xy++ = r1 * cos (angle);
+		*xy++ = r1 * sin (angle);
+		*xy++ = r2 * cos (angle + da);
+		*xy++ = r2 * sin (angle + da);
+		*xy++ = r2 * cos (angle + 2 * da);
+		*xy++ = r2 * sin (angle + 2 * da);
+
+		if (i < teeth) {
+			*xy++ = r1 * cos (angle + 3 * da);
+			*xy++ = r1 * sin (angle + 3 * da);
+		}
+	}
+}
+
+static inline void gear_path(cairo_t *cr, const double *xy, int teeth) {
+	cairo_new_path (cr);
+	cairo_move_to (cr, xy[0], xy[1]);
+	for (int i = 1; i < 4 * teeth; i++)
+		cairo_line_to (cr, xy[2*i], xy[2*i+1]);
+	cairo_close_path (cr);
+}
+
+static inline void calcVertexes(double start_x, double start_y,
+						double end_x, double end_y, 
+						double arrow_degrees_, double arrow_lenght_, double diamant_,
+						double *x1, double *y1, double *x2, double *y2,
+						double *x3, double *y3) {
+
+	double angle = atan2 (end_y - start_y, end_x - start_x) + M_PI;
+
+	*(x1) = end_x + arrow_lenght_ * cos(angle - arrow_degrees_);
+	*(y1) = end_y + arrow_lenght_ * sin(angle - arrow_degrees_);
+	*(x2) = end_x + arrow_lenght_ * cos(angle + arrow_degrees_);
+	*(y2) = end_y + arrow_lenght_ * sin(angle + arrow_degrees_);
+	*(x3) = end_x + arrow_lenght_ * diamant_ * cos(angle);
+	*(y3) = end_y + arrow_lenght_ * diamant_ * sin(angle);
+}
+
+#define GEAR_TEETH 9
+
+/** the gear outlines and the patterns of a knob size, built once
+ *  and reused by every frame, the gears are placed with the rotation matrix.
+ *  At most KNOB_SHAPES_MAX sizes are kept, the least recent used ones which
+ *  no knob_geometry hold get dropped, so drawing at ever new sizes (a plugin
+ *  which follow the window size) don't grow the cache without end **/
+#define KNOB_SHAPES_MAX 16
+
+typedef struct knob_shapes {
+	int knob_size;
+	int knob_offset;
+	double gear[8 * GEAR_TEETH];
+	double gear_small[8 * GEAR_TEETH];
+	cairo_pattern_t *gear_pat;
+	cairo_pattern_t *shading_pat;
+	// knob_geometry's using it, and the last use for the lru order
+	int users;
+	unsigned long used;
+	struct knob_shapes *next;
+} knob_shapes;
+
+// knob geometry, the same for every frame of a given size and offset
+typedef struct {
+	int arc_offset;
+	double knob_x;
+	double knob_y;
+	double knobx;
+	double knobx1;
+	double knoby;
+	double knoby1;
+	double pointer_off;
+	double radius;
+	const knob_shapes *shapes;
+} knob_geometry;
+
+static knob_shapes *shape_cache = NULL;
+static int shape_count = 0;
+static unsigned long shape_tick = 0;
+static pthread_mutex_t shape_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static inline void knob_shapes_free(knob_shapes *sh) {
+	cairo_pattern_destroy(sh->gear_pat);
+	cairo_pattern_destroy(sh->shading_pat);
+	free(sh);
+}
+
+// drop unused shapes, least recent used first, until the cache is down to KNOB_SHAPES_MAX
+static inline void knob_shapes_trim() {
+	while (shape_count > KNOB_SHAPES_MAX) {
+		knob_shapes **oldest = NULL;
+		for (knob_shapes **p = &shape_cache; *p; p = &(*p)->next)
+			if (!(*p)->users && (!oldest || (*p)->used < (*oldest)->used)) oldest = p;
+		if (!oldest) break;
+		knob_shapes *sh = *oldest;
+		*oldest = sh->next;
+		knob_shapes_free(sh);
+		shape_count--;
+	}
+}
+
+/** get the cached shapes for the geometry, create them on first use,
+ *  they stay valid until knob_shapes_release() **/
+static inline const knob_shapes *knob_shapes_get(const knob_geometry *g, int knob_size, int knob_offset) {
+	pthread_mutex_lock(&shape_lock);
+	knob_shapes *sh = shape_cache;
+	while (sh && (sh->knob_size != knob_size || sh->knob_offset != knob_offset))
+		sh = sh->next;
+	if (!sh) {
+		sh = (knob_shapes*)calloc(1, sizeof(knob_shapes));
+		sh->knob_size = knob_size;
+		sh->knob_offset = knob_offset;
+
+		gear_vertexes(g->radius-10.0, GEAR_TEETH, 10.0, sh->gear);
+		gear_vertexes(g->radius-15.0, GEAR_TEETH, 6.0, sh->gear_small);
+
+		sh->gear_pat = cairo_pattern_create_radial (0.0,0.0, 1,0.0,0.0,g->knob_x/2.0 );
+		cairo_pattern_add_color_stop_rgba (sh->gear_pat, 1,  0.1, 0.2, 0.1, 1.0);
+		cairo_pattern_add_color_stop_rgba (sh->gear_pat, 0,  0.05, 0.15, 0.05, 1.0);
+		sh->shading_pat = shading_pattern(g->arc_offset, g->knobx1, g->knoby1, g->knob_x);
+
+		sh->next = shape_cache;
+		shape_cache = sh;
+		shape_count++;
+	}
+	sh->users++;
+	sh->used = ++shape_tick;
+	knob_shapes_trim();
+	pthread_mutex_unlock(&shape_lock);
+	return sh;
+}
+
+static inline void knob_shapes_release(const knob_shapes *shapes) {
+	pthread_mutex_lock(&shape_lock);
+	((knob_shapes*)shapes)->users--;
+	pthread_mutex_unlock(&shape_lock);
+}
+
+// free all shapes, only call it when nothing is drawn, like at exit
+static inline void knob_shapes_clear() {
+	pthread_mutex_lock(&shape_lock);
+	while (shape_cache) {
+		knob_shapes *sh = shape_cache;
+		shape_cache = sh->next;
+		knob_shapes_free(sh);
+	}
+	shape_count = 0;
+	pthread_mutex_unlock(&shape_lock);
+}
+
+static inline void knob_geometry_init(knob_geometry *g, int knob_size, int knob_offset) {
+	/** set knob size **/
+	int arc_offset = knob_offset;
+	g->arc_offset = arc_offset;
+	g->knob_x = knob_size-arc_offset;
+	g->knob_y = knob_size-arc_offset;
+	g->knobx = arc_offset/2;
+	g->knobx1 = g->knob_x/2;
+	g->knoby = arc_offset/2;
+	g->knoby1 = g->knob_y/2;
+	g->pointer_off = g->knob_x/10;
+	g->radius = min(g->knob_x-g->pointer_off, g->knob_y-g->pointer_off) / 2;
+	g->shapes = knob_shapes_get(g, knob_size, knob_offset);
+}
+
+// give the shapes back, every knob_geometry_init() need one
+static inline void knob_geometry_release(knob_geometry *g) {
+	if (g->shapes) knob_shapes_release(g->shapes);
+	g->shapes = NULL;
+}
+
+// the parts which don't move, drawn below the gears
+static inline void paint_knob_base(cairo_t *cr, const knob_geometry *g) {
+	int arc_offset = g->arc_offset;
+	double knob_x = g->knob_x;
+	double knobx1 = g->knobx1;
+	double knoby1 = g->knoby1;
+
+	cairo_new_path (cr);
+
+	/** create the knob, set the knob and border color to your needs,
+	 *  or set knob color alpa to 0.0 to draw only the border **/
+
+	cairo_arc(cr,knobx1+arc_offset/2, knoby1+arc_offset/2, knob_x/2.1, 0, 2 * M_PI );
+	knob_role_source(cr, KNOB_ROLE_BODY, 0.0, 0.0, 0.0, 1.0); // knob color
+	cairo_fill_preserve (cr);
+ 	knob_role_source(cr, KNOB_ROLE_BORDER, 0.1, 0.2, 0.1, 1.0); // knob border color
+	cairo_set_line_width(cr,4);
+	cairo_set_line_cap(cr, CAIRO_LINE_CAP_ROUND);
+	cairo_set_line_join(cr, CAIRO_LINE_JOIN_BEVEL);
+	cairo_stroke(cr);
+	cairo_new_path (cr);
+}
+
+// the gears, they rotate with the knob state
+static inline void paint_knob_gears(cairo_t *cr, const knob_geometry *g, double angle) {
+	double knobx1 = g->knobx1;
+	double knoby1 = g->knoby1;
+
+	/** create a rotating gear on the knob,
+	 * set the color to your needs, the gear and the gradient
+	 * are made in knob_shapes_get() **/
+
+ 	cairo_save (cr);
+	cairo_translate (cr, knobx1, knoby1);
+	cairo_rotate (cr, angle-0.08); // adjust tooth to pointer
+
+	gear_path (cr, g->shapes->gear, GEAR_TEETH);
+
+	knob_role_pattern(cr, KNOB_ROLE_GEAR, g->shapes->gear_pat);
+	cairo_fill_preserve (cr);
+	cairo_set_line_width(cr,1);
+	cairo_set_line_cap(cr, CAIRO_LINE_CAP_ROUND);
+	cairo_set_line_join(cr, CAIRO_LINE_JOIN_BEVEL);
+	knob_role_source(cr, KNOB_ROLE_GEAR_EDGE, 0.2, 0.2, 0.2, 1.0);
+	cairo_stroke (cr);
+	cairo_restore (cr);
+	cairo_save (cr);
+ 
+	/** create a 2. smaller rotating gear on the knob,
+	 * set the color to your needs **/
+
+	cairo_translate (cr, knobx1, knoby1);
+	cairo_rotate (cr, angle-0.08); // adjust tooth to pointer
+
+	gear_path (cr, g->shapes->gear_small, GEAR_TEETH);
+
+	knob_role_source(cr, KNOB_ROLE_HUB, 0.0, 0.0, 0.0, 1.0);
+	cairo_fill (cr);
+	cairo_restore (cr);
+}
+
+// the pointer, it rotates with the knob state
+static inline void paint_knob_pointer(cairo_t *cr, const knob_geometry *g, double angle) {
+	int arc_offset = g->arc_offset;
+	double knobx = g->knobx;
+	double knobx1 = g->knobx1;
+	double knoby = g->knoby;
+	double knoby1 = g->knoby1;
+	double pointer_off = g->pointer_off;
+	double radius = g->radius;
+
+	/** calculate the pointer **/
+	double length_x = (knobx+radius+pointer_off/2) - radius * sin(angle);
+	double length_y = (knoby+radius+pointer_off/2) + radius * cos(angle);
+	double radius_x = (knobx+radius+pointer_off/2) - radius/ 1.7 * sin(angle);
+	double radius_y = (knoby+radius+pointer_off/2) + radius/ 1.7 * cos(angle);
+
+	cairo_save (cr);
+
+	/** create the rotating pointer on the knob,
+	 * set the color to your needs **/
+
+	double x1 = 0;
+	double y1 = 0;
+	double x2 = 0;
+	double y2 = 0;
+	double x3 = 0;
+	double y3 = 0;
+	double degrees_ = 0.35;
+	double lenght_ = 10.0;
+	double diamant_ = 0.1;
+	
+	/** create a arrow for given lengh and degrees **/
+
+	calcVertexes(knobx1+arc_offset/2, knoby1+arc_offset/2, radius_x, radius_y,
+				 degrees_, lenght_, diamant_, &x1, &y1, &x2, &y2, &x3, &y3);
+	
+	cairo_set_line_cap(cr, CAIRO_LINE_CAP_ROUND);
+	cairo_set_line_join(cr, CAIRO_LINE_JOIN_BEVEL);
+	cairo_move_to(cr, length_x, length_y);
+	cairo_curve_to (cr,length_x, length_y,x1,y1,x3,y3);
+	cairo_curve_to (cr,x3,y3,x2,y2,length_x, length_y);
+	//cairo_line_to(cr,x1,y1);
+	//cairo_line_to(cr,x3,y3);
+	//cairo_line_to(cr,x2,y2);
+	//cairo_line_to(cr,length_x, length_y);
+	knob_role_source(cr, KNOB_ROLE_POINTER, 1.0, 1.0, 1.0, 1.0);
+	cairo_fill_preserve (cr);
+	knob_role_source(cr, KNOB_ROLE_POINTER_EDGE, 0.0, 0.0, 0.0, 1.0);
+	cairo_set_line_width(cr,1);
+	cairo_stroke(cr);
+	cairo_restore (cr);
+}
+
+// the parts which don't move, drawn on top of everything
+static inline void paint_knob_overlay(cairo_t *cr, const knob_geometry *g) {
+	int arc_offset = g->arc_offset;
+	double knob_x = g->knob_x;
+	double knobx1 = g->knobx1;
+	double knoby1 = g->knoby1;
+
+	/** create a inner ring on the knob **/
+	//inner_ring(cr, arc_offset, knobx1, knoby1, knob_x);
+
+	/** 3d shading comment out, or set alpa to 0.0, for flat knobs
+	 * or set alpa to a higher value for more shading effect,
+	 * the gradient is made once per size in shading_pattern() **/
+	shading(cr, arc_offset, knobx1, knoby1, knob_x, g->shapes->shading_pat);
+}
+
+static inline void paint_knob_state(cairo_t *cr, int knob_size, int knob_offset, double knobstate)
+{
+	knob_geometry g;
+	knob_geometry_init(&g, knob_size, knob_offset);
+	double angle = scale_zero + knobstate * 2 * (M_PI - scale_zero);
+
+	double t = trace_begin();
+	paint_knob_base(cr, &g);
+	t = trace_next("base", t);
+	paint_knob_gears(cr, &g, angle);
+	t = trace_next("gears", t);
+	paint_knob_pointer(cr, &g, angle);
+	t = trace_next("pointer", t);
+
+	/** draw a ring indicator around the knob **/
+	draw_indicator_ring(cr, knobstate, g.radius, angle, g.knobx1+g.arc_offset/2, g.knoby1+g.arc_offset/2);
+	t = trace_next("ring", t);
+
+	/**  use this for a simple pointer **/
+   // cairo_move_to(cr, radius_x, radius_y);
+   // cairo_line_to(cr,length_x,length_y);
+
+	paint_knob_overlay(cr, &g);
+	trace_end("overlay", t);
+	knob_geometry_release(&g);
+}
+
+/** the layered renderer draws the state independent parts once per size
+ *  into cached image surfaces, each frame then only draws the gears,
+ *  the pointer and the ring foreground between them **/
+typedef struct knob_layers {
+	int knob_size;
+	int knob_offset;
+	knob_geometry g;
+	cairo_surface_t *base;
+	cairo_surface_t *ring;
+	cairo_surface_t *overlay;
+	struct knob_layers *next;
+} knob_layers;
+
+static knob_layers *layer_cache = NULL;
+static pthread_mutex_t layer_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// get the cached layers for knob_size and knob_offset, create them on first use
+static inline knob_layers *knob_layers_get(int knob_size, int knob_offset) {
+	pthread_mutex_lock(&layer_lock);
+	knob_layers *l = layer_cache;
+	while (l && (l->knob_size != knob_size || l->knob_offset != knob_offset))
+		l = l->next;
+	if (!l) {
+		l = (knob_layers*)calloc(1, sizeof(knob_layers));
+		l->knob_size = knob_size;
+		l->knob_offset = knob_offset;
+		knob_geometry_init(&l->g, knob_size, knob_offset);
+
+		l->base = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, knob_size, knob_size);
+		cairo_t *cr = cairo_create(l->base);
+		paint_knob_base(cr, &l->g);
+		cairo_destroy(cr);
+
+		l->ring = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, knob_size, knob_size);
+		cr = cairo_create(l->ring);
+		draw_indicator_ring_background(cr, l->g.radius, l->g.knobx1+l->g.arc_offset/2,
+									   l->g.knoby1+l->g.arc_offset/2);
+		cairo_destroy(cr);
+
+		l->overlay = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, knob_size, knob_size);
+		cr = cairo_create(l->overlay);
+		paint_knob_overlay(cr, &l->g);
+		cairo_destroy(cr);
+
+		l->next = layer_cache;
+		layer_cache = l;
+	}
+	pthread_mutex_unlock(&layer_lock);
+	return l;
+}
+
+static inline void knob_layers_clear() {
+	pthread_mutex_lock(&layer_lock);
+	while (layer_cache) {
+		knob_layers *l = layer_cache;
+		layer_cache = l->next;
+		cairo_surface_destroy(l->base);
+		cairo_surface_destroy(l->ring);
+		cairo_surface_destroy(l->overlay);
+		knob_geometry_release(&l->g);
+		free(l);
+	}
+	pthread_mutex_unlock(&layer_lock);
+}
+
+static inline void paint_knob_layered(cairo_t *cr, int knob_size, int knob_offset, double knobstate)
+{
+	knob_layers *l = knob_layers_get(knob_size, knob_offset);
+	double angle = scale_zero + knobstate * 2 * (M_PI - scale_zero);
+
+	cairo_set_source_surface(cr, l->base, 0, 0);
+	cairo_paint(cr);
+	paint_knob_gears(cr, &l->g, angle);
+	paint_knob_pointer(cr, &l->g, angle);
+	cairo_set_source_surface(cr, l->ring, 0, 0);
+	cairo_paint(cr);
+	draw_indicator_ring_foreground(cr, l->g.radius, angle, l->g.knobx1+l->g.arc_offset/2,
+								   l->g.knoby1+l->g.arc_offset/2);
+	cairo_set_source_surface(cr, l->overlay, 0, 0);
+	cairo_paint(cr);
+}
+
+#endif //KNOB_DRAW_H
@@ -0,0 +1,152 @@
+#include <cairo.h>
+#include <math.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// gcc -O2 -g knob_error.c -lm -lpthread `pkg-config --cflags --libs cairo` -o knoberror
+
+#include "knob_render.h"
+
+/** measure the error of knobview -i, which store less frames and blend the
+ *  frames in between. For each stored frame count the full strip is compared
+ *  against the blended frames, at the value each full frame is shown for **/
+
+typedef struct {
+	double psnr;
+	double worst_psnr;
+	int worst_frame;
+	int max_error;
+} blend_error;
+
+static double psnr_of(double sq, double count) {
+	if (sq == 0.0) return INFINITY;
+	return 10.0 * log10(255.0 * 255.0 / (sq / count));
+}
+
+/** knobview show frame (int)(s * value) of a strip with s + 1 frames,
+ *  so full frame i is shown at value i / (frames - 1). With -i blend it
+ *  show step (int)(s * blend * value), stored frame step / blend mixed
+ *  with the next one by t = (step % blend) / blend, like draw_controller()
+ *  does, blend < 2 show the stored frames only **/
+static void measure(const unsigned char *full, int frames, const unsigned char *stored, int count,
+					int size, int blend, blend_error *e) {
+	size_t frame_bytes = (size_t)size * size * 4;
+	double sq_all = 0.0;
+	e->worst_psnr = INFINITY;
+	e->worst_frame = 0;
+	e->max_error = 0;
+	if (blend < 2) blend = 1;
+	for (int i = 0; i < frames; i++) {
+		double value = (frames > 1) ? (double)i / (frames - 1) : 0.0;
+		int findex = (int)((count - 1) * blend * value);
+		int f0 = min(findex / blend, count - 1);
+		int f1 = min(f0 + 1, count - 1);
+		double t = (double)(findex % blend) / blend;
+		const unsigned char *a = stored + f0 * frame_bytes;
+		const unsigned char *b = stored + f1 * frame_bytes;
+		const unsigned char *ref = full + i * frame_bytes;
+		double sq = 0.0;
+		for (size_t k = 0; k < frame_bytes; k++) {
+			int v = (int)(a[k] * (1.0 - t) + b[k] * t + 0.5);
+			int d = abs(v - ref[k]);
+			if (d > e->max_error) e->max_error = d;
+			sq += d * d;
+		}
+		sq_all += sq;
+		double psnr = psnr_of(sq, frame_bytes);
+		if (psnr < e->worst_psnr) {
+			e->worst_psnr = psnr;
+			e->worst_frame = i;
+		}
+	}
+	e->psnr = psnr_of(sq_all, (double)frame_bytes * frames);
+}
+
+// render frames like knobmake does, frame i at state i / frames
+static unsigned char *render_set(int size, int offset, int frames) {
+	size_t frame_bytes = (size_t)size * size * 4;
+	unsigned char *data = (unsigned char*)malloc(frame_bytes * frames);
+	if (!data) return NULL;
+	for (int i = 0; i < frames; i++) {
+		if (knob_render_frame(KNOB_STYLE_KNOB, size, offset, (double)i / frames,
+							  data + i * frame_bytes, size * 4)) {
+			free(data);
+			return NULL;
+		}
+	}
+	return data;
+}
+
+int main(int argc, char* argv[])
+{
+	int offset = 0;
+	int blend = 0;
+	int opt;
+	while ((opt = getopt(argc, argv, "o:i:")) != -1) {
+		switch (opt) {
+			case 'o':
+				// knob offset, like the third argument of knobmake
+				offset = atoi(optarg);
+			break;
+			case 'i':
+				// the -i steps of knobview, 0 take the steps which give each full frame its own step
+				blend = max(0, atoi(optarg));
+			break;
+			default:
+				argc = 0;
+			break;
+		}
+	}
+	if (argc - optind < 2) {
+		fprintf(stdout, "usage: %s [-o offset] [-i steps] knob_size frame_count [stored_frames ...]\nexample:\n  ./%s 150 101 11 21 31\n",
+				basename(argv[0]), basename(argv[0]));
+		return 1;
+	}
+	int size = atoi(argv[optind]);
+	int frames = atoi(argv[optind + 1]);
+	if (size < 1 || frames < 2) {
+		fprintf(stderr, "need a size > 0 and at least 2 frames\n");
+		return 1;
+	}
+
+	static const int default_counts[] = {6, 11, 16, 21, 31, 51};
+	int ncounts = argc - optind - 2;
+	int counts[64];
+	if (ncounts > 64) ncounts = 64;
+	for (int i = 0; i < ncounts; i++) counts[i] = atoi(argv[optind + 2 + i]);
+	if (!ncounts) {
+		for (unsigned i = 0; i < sizeof(default_counts) / sizeof(default_counts[0]); i++)
+			if (default_counts[i] < frames) counts[ncounts++] = default_counts[i];
+	}
+
+	unsigned char *full = render_set(size, offset, frames);
+	if (!full) {
+		fprintf(stderr, "could not render %i frames of %i px\n", frames, size);
+		return 1;
+	}
+	size_t frame_bytes = (size_t)size * size * 4;
+	fprintf(stdout, "%i px, %i frames, %.1f MiB resident\n", size, frames, frame_bytes * frames / 1048576.0);
+	fprintf(stdout, "stored  steps  psnr dB  worst dB  at frame  max error  resident MiB\n");
+	for (int c = 0; c < ncounts; c++) {
+		int count = counts[c];
+		if (count < 2 || count > frames) {
+			fprintf(stderr, "%i stored frames: skipped, need 2 - %i\n", count, frames);
+			continue;
+		}
+		unsigned char *stored = render_set(size, offset, count);
+		if (!stored) continue;
+		int steps = blend ? blend : ((frames - 1) + (count - 2)) / (count - 1);
+		blend_error e;
+		measure(full, frames, stored, count, size, steps, &e);
+		fprintf(stdout, "%6i  %5i  %7.1f  %8.1f  %8i  %9i  %12.1f\n", count, steps, e.psnr, e.worst_psnr,
+				e.worst_frame, e.max_error, frame_bytes * count / 1048576.0);
+		free(stored);
+	}
+	free(full);
+	knob_shapes_clear();
+	switch_patterns_clear();
+	return 0;
+}
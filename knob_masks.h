@@ -0,0 +1,76 @@
+#ifndef KNOB_MASKS_H
+#define KNOB_MASKS_H
+
+#include <cairo.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "knob_draw.h"
+#include "strip.h"
+#include "strip_masks.h"
+
+/** knobmake -m, render the knob once per color role as a coverage mask,
+ *  and the shading as ARGB32, to name.masks. knobtheme then build any
+ *  number of themed strips from it without drawing the knob again.
+ *  Gradients (the gear) get a flat color in the themed strips **/
+
+static inline int knob_masks_write(int knob_size, int knob_frames, int knob_offset,
+							const strip_options *o, const char *name) {
+	if (knob_size < 1 || knob_frames < 1) {
+		fprintf(stderr, "%s: need a size and a frame count > 0\n", name);
+		return 1;
+	}
+	// the masks are drawn straight into image strips
+	strip_options mo = *o;
+	mo.formats = STRIP_PNG;
+
+	strip_masks m;
+	memset(&m, 0, sizeof(strip_masks));
+	strip_meta_init(&m.layout, knob_size, knob_frames);
+	strip_meta_layout(&m.layout, o->columns);
+	if (strip_check_size(&m.layout, &mo, name)) return 1;
+	int width = knob_size * m.layout.columns;
+	int height = knob_size * m.layout.rows;
+
+	int ret = 0;
+	cairo_surface_t *planes[KNOB_ROLES + 1];
+	m.planes = KNOB_ROLES + 1;
+	double start = strip_now();
+	for (int i = 0; i < m.planes; i++) {
+		planes[i] = cairo_image_surface_create(i == KNOB_ROLE_SHADE ? CAIRO_FORMAT_ARGB32 : CAIRO_FORMAT_A8,
+											   width, height);
+		if (cairo_surface_status(planes[i]) != CAIRO_STATUS_SUCCESS) {
+			fprintf(stderr, "%s: could not create the %s mask\n", name, knob_role_names[i]);
+			ret = 1;
+		}
+		cairo_t *cr = cairo_create(planes[i]);
+		knob_mask_role = i;
+		if (!ret) strip_render(cr, paint_knob_state, &m.layout, knob_offset, &mo);
+		cairo_destroy(cr);
+		cairo_surface_flush(planes[i]);
+
+		strip_plane *p = &m.plane[i];
+		snprintf(p->name, sizeof(p->name), "%s", knob_role_names[i]);
+		p->bpp = (i == KNOB_ROLE_SHADE) ? 4 : 1;
+		p->data = cairo_image_surface_get_data(planes[i]);
+		p->stride = cairo_image_surface_get_stride(planes[i]);
+		if (i < KNOB_ROLES)
+			for (int k = 0; k < 4; k++) p->color[k] = (unsigned char)(knob_role_colors[i][k] * 255.0 + 0.5);
+	}
+	knob_mask_role = -1;
+	double render = strip_now() - start;
+
+	char masks_file[512];
+	snprintf(masks_file, sizeof(masks_file), "%s.masks", name);
+	if (!ret && strip_masks_write(&m, o->zlevel, masks_file)) {
+		fprintf(stderr, "could not write %s\n", masks_file);
+		ret = 1;
+	}
+	if (!ret)
+		fprintf(stdout, "%s: %i masks rendered in %.1f ms\n", masks_file, m.planes, render * 1e3);
+	for (int i = 0; i < m.planes; i++) cairo_surface_destroy(planes[i]);
+	strip_meta_free(&m.layout);
+	return ret;
+}
+
+#endif //KNOB_MASKS_H
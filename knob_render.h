@@ -0,0 +1,195 @@
+#ifndef KNOB_RENDER_H
+#define KNOB_RENDER_H
+
+#include <cairo.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "knob_draw.h"
+#include "switch_draw.h"
+
+/** render single frames on demand, for plugins which draw the widgets at the
+ *  size they are shown, instead of loading a prerendered strip.
+ *  Include this header and link with cairo, libm and pthread.
+ *  Frames are premultiplied ARGB32 in cairo layout, so the buffer can be
+ *  wrapped with cairo_image_surface_create_for_data().
+ *  The gear shapes and switch gradients are cached per size outside of the
+ *  knob_cache budget, up to KNOB_SHAPES_MAX and SWITCH_PATTERNS_MAX sizes,
+ *  call knob_shapes_clear() and switch_patterns_clear() when nothing is drawn
+ *  anymore to free them **/
+
+typedef enum {
+	KNOB_STYLE_KNOB,
+	KNOB_STYLE_SWITCH,
+	KNOB_STYLE_COUNT,
+} knob_style;
+
+// render one frame into data, stride is in bytes, returns non zero on error
+static inline int knob_render_frame(knob_style style, int size, int offset, double state,
+							 unsigned char *data, int stride) {
+	if (style < 0 || style >= KNOB_STYLE_COUNT || size < 1 || stride < size * 4 || stride % 4) return 1;
+	cairo_surface_t *s = cairo_image_surface_create_for_data(data, CAIRO_FORMAT_ARGB32, size, size, stride);
+	cairo_t *cr = cairo_create(s);
+	// the buffer may hold anything, start transparent
+	cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+	cairo_paint(cr);
+	cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+	state = min(1.0, max(0.0, state));
+	if (style == KNOB_STYLE_KNOB) paint_knob_state(cr, size, offset, state);
+	else paint_switch_state(cr, size, offset, state);
+	cairo_destroy(cr);
+	cairo_surface_flush(s);
+	int ret = cairo_surface_status(s) != CAIRO_STATUS_SUCCESS;
+	cairo_surface_destroy(s);
+	return ret;
+}
+
+/** the frame cache, holds the last used frames up to max_bytes,
+ *  the state is rounded to one of steps positions, like a strip with steps frames **/
+
+#define KNOB_CACHE_BUCKETS 256
+
+typedef struct knob_frame {
+	knob_style style;
+	int size;
+	int offset;
+	int step;
+	// lru list, most recent used first
+	struct knob_frame *prev;
+	struct knob_frame *next;
+	// hash bucket chain
+	struct knob_frame *chain;
+	unsigned char data[];
+} knob_frame;
+
+typedef struct {
+	int steps;
+	size_t max_bytes;
+	size_t bytes;
+	knob_frame *first;
+	knob_frame *last;
+	knob_frame *buckets[KNOB_CACHE_BUCKETS];
+	int hits;
+	int misses;
+	pthread_mutex_t lock;
+} knob_cache;
+
+static inline void knob_cache_init(knob_cache *c, size_t max_bytes, int steps) {
+	memset(c, 0, sizeof(knob_cache));
+	c->steps = max(2, steps);
+	c->max_bytes = max_bytes;
+	pthread_mutex_init(&c->lock, NULL);
+}
+
+static inline unsigned knob_cache_hash(knob_style style, int size, int offset, int step) {
+	unsigned h = (unsigned)style;
+	h = h * 31u + (unsigned)size;
+	h = h * 31u + (unsigned)offset;
+	h = h * 131u + (unsigned)step;
+	return h % KNOB_CACHE_BUCKETS;
+}
+
+static inline size_t knob_frame_bytes(int size) {
+	return sizeof(knob_frame) + (size_t)size * size * 4;
+}
+
+static inline void knob_cache_unlink(knob_cache *c, knob_frame *f) {
+	if (f->prev) f->prev->next = f->next;
+	else c->first = f->next;
+	if (f->next) f->next->prev = f->prev;
+	else c->last = f->prev;
+	f->prev = f->next = NULL;
+}
+
+static inline void knob_cache_push_front(knob_cache *c, knob_frame *f) {
+	f->prev = NULL;
+	f->next = c->first;
+	if (c->first) c->first->prev = f;
+	c->first = f;
+	if (!c->last) c->last = f;
+}
+
+// drop the least recent used frame
+static inline void knob_cache_evict(knob_cache *c) {
+	knob_frame *f = c->last;
+	knob_cache_unlink(c, f);
+	knob_frame **p = &c->buckets[knob_cache_hash(f->style, f->size, f->offset, f->step)];
+	while (*p != f) p = &(*p)->chain;
+	*p = f->chain;
+	c->bytes -= knob_frame_bytes(f->size);
+	free(f);
+}
+
+static inline void knob_cache_clear(knob_cache *c) {
+	pthread_mutex_lock(&c->lock);
+	while (c->last) knob_cache_evict(c);
+	pthread_mutex_unlock(&c->lock);
+}
+
+static inline void knob_cache_free(knob_cache *c) {
+	knob_cache_clear(c);
+	pthread_mutex_destroy(&c->lock);
+}
+
+static inline knob_frame *knob_cache_find(knob_cache *c, knob_style style, int size, int offset, int step) {
+	knob_frame *f = c->buckets[knob_cache_hash(style, size, offset, step)];
+	while (f && (f->style != style || f->size != size || f->offset != offset || f->step != step)) f = f->chain;
+	return f;
+}
+
+static inline void knob_frame_copy(const knob_frame *f, unsigned char *data, int stride) {
+	for (int y = 0; y < f->size; y++)
+		memcpy(data + (size_t)y * stride, f->data + (size_t)y * f->size * 4, (size_t)f->size * 4);
+}
+
+/** copy the frame for state into data, render it when it isn't cached.
+ *  Can be called from several threads, the rendering itself run unlocked **/
+static inline int knob_cache_render(knob_cache *c, knob_style style, int size, int offset, double state,
+							 unsigned char *data, int stride) {
+	if (style < 0 || style >= KNOB_STYLE_COUNT || size < 1 || stride < size * 4 || stride % 4) return 1;
+	int step = (int)(min(1.0, max(0.0, state)) * (c->steps - 1) + 0.5);
+
+	pthread_mutex_lock(&c->lock);
+	knob_frame *f = knob_cache_find(c, style, size, offset, step);
+	if (f) {
+		c->hits++;
+		knob_cache_unlink(c, f);
+		knob_cache_push_front(c, f);
+		knob_frame_copy(f, data, stride);
+		pthread_mutex_unlock(&c->lock);
+		return 0;
+	}
+	c->misses++;
+	pthread_mutex_unlock(&c->lock);
+
+	f = (knob_frame*)malloc(knob_frame_bytes(size));
+	if (!f) return 1;
+	f->style = style;
+	f->size = size;
+	f->offset = offset;
+	f->step = step;
+	if (knob_render_frame(style, size, offset, (double)step / (c->steps - 1), f->data, size * 4)) {
+		free(f);
+		return 1;
+	}
+
+	pthread_mutex_lock(&c->lock);
+	knob_frame_copy(f, data, stride);
+	// another thread may have rendered the same frame meanwhile
+	if (knob_cache_find(c, style, size, offset, step) || knob_frame_bytes(size) > c->max_bytes) {
+		free(f);
+	} else {
+		unsigned h = knob_cache_hash(style, size, offset, step);
+		f->chain = c->buckets[h];
+		c->buckets[h] = f;
+		knob_cache_push_front(c, f);
+		c->bytes += knob_frame_bytes(size);
+		while (c->bytes > c->max_bytes) knob_cache_evict(c);
+	}
+	pthread_mutex_unlock(&c->lock);
+	return 0;
+}
+
+#endif //KNOB_RENDER_H
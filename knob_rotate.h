@@ -0,0 +1,88 @@
+#ifndef KNOB_ROTATE_H
+#define KNOB_ROTATE_H
+
+#include <cairo.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "knob_draw.h"
+#include "strip_rotate.h"
+
+/** knobmake -r, everything which moves on the knob is a rotation of the
+ *  gears and the pointer, only the ring grows. So the knob is written as
+ *  layers, the parts which don't move, the moving parts at the angle of
+ *  state 0, and the ring parameters, knobview rotate and draw them.
+ *  The gears rotate around knobx1,knoby1 and the pointer around the
+ *  center of the knob, with a offset these differ, then each get a sprite **/
+
+/** write the layers side by side to name.png and the parameters to name.rotate,
+ *  returns 0 on success **/
+static inline int knob_rotation_write(int knob_size, int knob_offset, const char *name) {
+	knob_geometry g;
+	knob_geometry_init(&g, knob_size, knob_offset);
+
+	strip_rotation r;
+	memset(&r, 0, sizeof(strip_rotation));
+	r.size = knob_size;
+	r.angle = scale_zero;
+	r.span = 2 * (M_PI - scale_zero);
+	double cx = g.knobx1+g.arc_offset/2;
+	double cy = g.knoby1+g.arc_offset/2;
+	r.sprite_x[0] = g.knobx1;
+	r.sprite_y[0] = g.knoby1;
+	r.sprites = 1;
+	if (cx != g.knobx1 || cy != g.knoby1) {
+		r.sprite_x[1] = cx;
+		r.sprite_y[1] = cy;
+		r.sprites = 2;
+	}
+	r.layers = 2 + r.sprites;
+	r.ring_x = cx;
+	r.ring_y = cy;
+	r.ring_radius = g.radius;
+	r.ring_width = ring_width;
+	r.ring_dash[0] = ring_dashes[0];
+	r.ring_dash[1] = ring_dashes[1];
+	r.ring_start = 90 * (M_PI / 180.) + scale_zero;
+	r.ring_sweep = ring_sweep;
+	for (int i = 0; i < 3; i++) {
+		r.ring_background[i] = ring_background[i];
+		r.ring_foreground[i] = ring_foreground[i];
+	}
+
+	cairo_surface_t *img = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, knob_size * r.layers, knob_size);
+	if (cairo_surface_status(img) != CAIRO_STATUS_SUCCESS) {
+		cairo_surface_destroy(img);
+		knob_geometry_release(&g);
+		return 1;
+	}
+	cairo_t *cr = cairo_create(img);
+	paint_knob_base(cr, &g);
+	cairo_translate(cr, knob_size, 0);
+	paint_knob_overlay(cr, &g);
+	cairo_translate(cr, knob_size, 0);
+	paint_knob_gears(cr, &g, r.angle);
+	if (r.sprites == 2) cairo_translate(cr, knob_size, 0);
+	paint_knob_pointer(cr, &g, r.angle);
+	cairo_destroy(cr);
+	knob_geometry_release(&g);
+
+	char png_file[512];
+	char rotate_file[512];
+	snprintf(png_file, sizeof(png_file), "%s.png", name);
+	snprintf(rotate_file, sizeof(rotate_file), "%s.rotate", name);
+	int ret = 0;
+	cairo_status_t status = cairo_surface_write_to_png(img, png_file);
+	if (status != CAIRO_STATUS_SUCCESS) {
+		fprintf(stderr, "could not write %s: %s\n", png_file, cairo_status_to_string(status));
+		ret = 1;
+	}
+	cairo_surface_destroy(img);
+	if (strip_rotation_write(rotate_file, &r)) {
+		fprintf(stderr, "could not write %s\n", rotate_file);
+		ret = 1;
+	}
+	return ret;
+}
+
+#endif //KNOB_ROTATE_H
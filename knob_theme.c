@@ -0,0 +1,106 @@
+#include <cairo.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// gcc -O2 -g knob_theme.c -lm -lpthread -lz `pkg-config --cflags --libs cairo` -o knobtheme
+
+#include "strip.h"
+#include "strip_masks.h"
+#include "strip_recolor.h"
+
+/** knobtheme, write a strip per theme of the palette file from the masks
+ *  of knobmake -m, the knob isn't drawn again, only the planes get colored
+ *  and composited. knob_150x101.masks with theme blue give knob_150x101_blue.png **/
+
+int main(int argc, char* argv[])
+{
+	strip_options o;
+	strip_options_init(&o);
+	o.formats = STRIP_PNG;
+	int opt;
+	trace_init("knobtheme");
+	while ((opt = getopt(argc, argv, STRIP_OPTIONS)) != -1) {
+		if (!strip_parse_option(&o, opt, optarg)) argc = 0;
+	}
+	if (argc - optind < 2) {
+		fprintf(stdout, "usage: %s [-j threads] [-f png,qoi,frames,c] [-z level] [-q colors [-d]] [-t] masks_file palette_file\n"
+						"example:\n  ./%s knob_150x101.masks themes.txt\n",
+						basename(argv[0]), basename(argv[0]));
+		return 1;
+	}
+	if (o.formats & STRIP_SVG) {
+		fprintf(stderr, "themed strips are raster only, svg is not written\n");
+		o.formats &= ~STRIP_SVG;
+		if (!o.formats) o.formats = STRIP_PNG;
+	}
+	if (o.nscales) {
+		fprintf(stderr, "-x is not used, the masks are made at one size\n");
+		o.nscales = 0;
+	}
+
+	const char *masks_file = argv[optind];
+	strip_masks m;
+	double t = trace_begin();
+	if (strip_masks_read(masks_file, &m)) {
+		fprintf(stderr, "could not read %s\n", masks_file);
+		return 1;
+	}
+	trace_end("load", t);
+	strip_theme *themes;
+	int count = strip_themes_read(argv[optind + 1], &m, &themes);
+	if (count < 0) {
+		strip_masks_free(&m);
+		return 1;
+	}
+
+	// the output names start with the masks file name
+	char base[512];
+	snprintf(base, sizeof(base), "%s", masks_file);
+	size_t len = strlen(base);
+	if (len > 6 && strcmp(base + len - 6, ".masks") == 0) base[len - 6] = '\0';
+
+	int width = m.layout.size * m.layout.columns;
+	int height = m.layout.size * m.layout.rows;
+	int failed = 0;
+	for (int i = 0; i < count; i++) {
+		cairo_surface_t *img = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+		if (cairo_surface_status(img) != CAIRO_STATUS_SUCCESS) {
+			fprintf(stderr, "could not create %ix%i strip\n", width, height);
+			cairo_surface_destroy(img);
+			failed++;
+			break;
+		}
+		uint32_t colors[MASKS_MAX_PLANES];
+		for (int k = 0; k < m.planes; k++) colors[k] = recolor_pixel(themes[i].color[k]);
+
+		double start = strip_now();
+		t = trace_begin();
+		cairo_surface_flush(img);
+		strip_recolor(&m, colors, cairo_image_surface_get_data(img), cairo_image_surface_get_stride(img));
+		cairo_surface_mark_dirty(img);
+		trace_end("recolor", t);
+		double recolor = strip_now() - start;
+
+		char name[600];
+		snprintf(name, sizeof(name), "%s_%s", base, themes[i].name);
+		// strip_save could trim the layout, so each theme get its own copy
+		strip_meta layout = m.layout;
+		layout.rects = NULL;
+		layout.trimmed = 0;
+		if (strip_save(img, &layout, &o, name)) {
+			failed++;
+		} else {
+			fprintf(stdout, "%s: recolored in %.1f ms\n", name, recolor * 1e3);
+		}
+		strip_meta_free(&layout);
+		cairo_surface_destroy(img);
+	}
+
+	free(themes);
+	strip_masks_free(&m);
+	if (failed) fprintf(stderr, "%i themes failed\n", failed);
+	return failed ? 1 : 0;
+}
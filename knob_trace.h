@@ -0,0 +1,119 @@
+#ifndef KNOB_TRACE_H
+#define KNOB_TRACE_H
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+/** opt-in tracing, set KNOB_TRACE to a path prefix and each tool write
+ *  the timed scopes as Chrome trace-event json to <prefix><tool>-<pid>.json,
+ *  load it in chrome://tracing or https://ui.perfetto.dev
+ *
+ *  KNOB_TRACE=/tmp/ ./knobmake 150 101
+ *
+ *  a scope is
+ *
+ *  double t = trace_begin();
+ *  ...
+ *  trace_end("name", t);
+ *
+ *  without KNOB_TRACE both are a test of trace_on only, no clock is read,
+ *  so the calls stay in the release build. Names must be string literals,
+ *  only the pointer is kept **/
+
+typedef struct {
+	const char *name;
+	double start;
+	double dur;
+	int tid;
+} trace_event;
+
+static int trace_on = 0;
+static trace_event *trace_events = NULL;
+static size_t trace_count = 0;
+static size_t trace_space = 0;
+static int trace_threads = 0;
+static double trace_t0 = 0.0;
+static char trace_file[512];
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread int trace_tid = 0;
+
+// microseconds
+static inline double trace_clock() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static inline double trace_begin() {
+	return trace_on ? trace_clock() : 0.0;
+}
+
+static inline void trace_record(const char *name, double start) {
+	double end = trace_clock();
+	pthread_mutex_lock(&trace_lock);
+	if (!trace_tid) trace_tid = ++trace_threads;
+	if (trace_count == trace_space) {
+		size_t space = trace_space ? trace_space * 2 : 4096;
+		trace_event *e = (trace_event*)realloc(trace_events, space * sizeof(trace_event));
+		if (!e) {
+			pthread_mutex_unlock(&trace_lock);
+			return;
+		}
+		trace_events = e;
+		trace_space = space;
+	}
+	trace_events[trace_count++] = (trace_event){name, start - trace_t0, end - start, trace_tid};
+	pthread_mutex_unlock(&trace_lock);
+}
+
+static inline void trace_end(const char *name, double start) {
+	if (trace_on) trace_record(name, start);
+}
+
+// end the scope and start the next one, for stages which follow each other
+static inline double trace_next(const char *name, double start) {
+	if (!trace_on) return 0.0;
+	trace_record(name, start);
+	return trace_clock();
+}
+
+// write the events, called at exit, call it before exec as well
+static inline void trace_flush() {
+	if (!trace_on) return;
+	pthread_mutex_lock(&trace_lock);
+	FILE *fp = fopen(trace_file, "w");
+	if (!fp) {
+		fprintf(stderr, "could not write trace %s\n", trace_file);
+	} else {
+		int pid = (int)getpid();
+		fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+		for (size_t i = 0; i < trace_count; i++) {
+			const trace_event *e = &trace_events[i];
+			fprintf(fp, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%i,\"tid\":%i}%s\n",
+					e->name, e->start, e->dur, pid, e->tid, (i + 1 < trace_count) ? "," : "");
+		}
+		fprintf(fp, "]}\n");
+		if (fclose(fp) == 0)
+			fprintf(stderr, "trace: %zu events to %s\n", trace_count, trace_file);
+	}
+	free(trace_events);
+	trace_events = NULL;
+	trace_count = trace_space = 0;
+	trace_on = 0;
+	pthread_mutex_unlock(&trace_lock);
+}
+
+// enable tracing when KNOB_TRACE is set, tool is the file name part
+static inline void trace_init(const char *tool) {
+	const char *prefix = getenv("KNOB_TRACE");
+	if (!prefix || !*prefix || trace_on) return;
+	snprintf(trace_file, sizeof(trace_file), "%s%s-%i.json", prefix, tool, (int)getpid());
+	trace_t0 = trace_clock();
+	trace_on = 1;
+	atexit(trace_flush);
+}
+
+#endif //KNOB_TRACE_H
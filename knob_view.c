@@ -1,13 +1,40 @@
 
 
+#include <libgen.h>
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <cairo.h>
 #include <cairo-xlib.h>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 
-// gcc -g knob_view.c  -lX11 `pkg-config --cflags --libs cairo` -o knobview 
+#include <X11/extensions/XShm.h>
+#include <sys/ipc.h>
+#include <sys/select.h>
+#include <sys/shm.h>
+#include <time.h>
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+#include <malloc.h>
+#endif
+
+#include "knob_trace.h"
+#include "strip_frames.h"
+#include "strip_index.h"
+#include "strip_meta.h"
+#include "strip_qoi.h"
+#include "strip_rotate.h"
+
+// memory used to keep scaled frames in knob_view
+#define SCALED_CACHE_BYTES (64*1024*1024)
+// repaint at most once per display refresh
+#define FRAME_TIME (1.0/60.0)
+// rotation strips have no frames, the knob value is cut into this many steps
+#define ROTATE_STEPS 4096
+
+// gcc -g knob_view.c  -lX11 -lXext -lm -lz `pkg-config --cflags --libs cairo` -o knobview 
 
 #ifndef min
 #define min(x, y) ((x) < (y) ? (x) : (y))
@@ -44,6 +71,9 @@ typedef struct {
 	adjustment adj;
 	alinment al;
 	type tp;
+	// frame index shown in the window, -1 when it needs a redraw,
+	// with -i it count the blended steps
+	int findex;
 } controller;
 
 // resize window
@@ -70,57 +100,498 @@ typedef struct {
 	cairo_surface_t *surface;
 	cairo_surface_t *image;
 	int w, h, s;
+	// frames per row in the image
+	int columns;
+	strip_meta meta;
+	// trimmed strips: the frame findex build from the base frame and its changed part
+	cairo_surface_t *frame;
+	int findex;
+	// palette strips are kept as indices, frame then hold the expanded frame findex
+	strip_indexed indexed;
+	// a mapped .frames container, each frame wrapped in a surface on first use
+	strip_frames frames;
+	cairo_surface_t **mapped;
 	re_scale rescale;
+	// -i, blend this many steps between two stored frames, 0 show the stored frames only
+	int blend;
+	// knobmake -r strips, image hold the layers, the sprites get rotated when drawn
+	int rotate;
+	strip_rotation rotation;
+	// frames scaled to rescale.c, filled on first use, dropped on resize
+	cairo_surface_t **scaled;
+	int scaled_size;
+	size_t scaled_bytes;
+	// redraw scheduler, input only mark the window for redraw
+	int redraw;
+	int damaged;
+	int drawn_width;
+	int drawn_height;
+	double last_draw;
+	// MIT-SHM back buffer, when use_shm is 0 we draw to a xlib surface
+	int use_shm;
+	XShmSegmentInfo shminfo;
+	XImage *ximage;
+	GC gc;
 
-	controller knob;
+	// the controllers on the panel, all use the same strip
+	controller *controllers;
+	int count;
+	int active;
+	// panel size in unscaled pixel
+	int panel_w;
+	int panel_h;
 	double start_value;
 	int pos_x;
 	int pos_y;
-	
+
+	// -p, replay a input trace on a image surface, without a display
+	int headless;
+	// -R, write the input to a trace file for -p
+	FILE *record;
+
+	// stress mode, animate all controllers and report the redraw cost
+	int stress;
+	int stress_redraws;
+	int stress_repainted;
+	double stress_time;
+	double stress_report;
 } viewport;
 
+// trimmed strips, restore the base where the last frame differs and copy the changed part of findex
+static void update_trimmed_frame(viewport *v, int findex) {
+	if (findex == v->findex) return;
+	cairo_t *cr = cairo_create(v->frame);
+	cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+	// the base frame is at 0,0 in the image
+	strip_rect *r = &v->meta.rects[v->findex];
+	if (r->w) {
+		cairo_set_source_surface(cr, v->image, 0, 0);
+		cairo_rectangle(cr, r->x, r->y, r->w, r->h);
+		cairo_fill(cr);
+	}
+	r = &v->meta.rects[findex];
+	if (r->w) {
+		cairo_set_source_surface(cr, v->image, r->x - r->sx, r->y - r->sy);
+		cairo_rectangle(cr, r->x, r->y, r->w, r->h);
+		cairo_fill(cr);
+	}
+	cairo_destroy(cr);
+	v->findex = findex;
+}
+
+// expand frame findex of a palette strip to ARGB32
+static void update_indexed_frame(viewport *v, int findex) {
+	if (findex == v->findex) return;
+	cairo_surface_flush(v->frame);
+	strip_indexed_expand(&v->indexed, v->h * (findex % v->columns), v->h * (findex / v->columns), v->h, v->h,
+						 cairo_image_surface_get_data(v->frame), cairo_image_surface_get_stride(v->frame));
+	cairo_surface_mark_dirty(v->frame);
+	v->findex = findex;
+}
+
+/** wrap frame findex of the container, the pixels stay in the mapping,
+ *  deflated frames get inflated here, NULL when the frame is broken **/
+static cairo_surface_t *get_mapped_frame(viewport *v, int findex) {
+	if (v->mapped[findex]) return v->mapped[findex];
+	unsigned char *data = strip_frames_get(&v->frames, findex);
+	if (!data) return NULL;
+	v->mapped[findex] = cairo_image_surface_create_for_data(data, CAIRO_FORMAT_ARGB32,
+									v->frames.size, v->frames.size, v->frames.stride);
+	return v->mapped[findex];
+}
+
+// set frame findex as source, at 0,0 in unscaled frame coordinates
+static void set_frame_source(viewport *v, cairo_t *cr, int findex) {
+	if (v->frames.map) {
+		cairo_surface_t *frame = get_mapped_frame(v, findex);
+		if (frame) cairo_set_source_surface (cr, frame, 0, 0);
+		else cairo_set_source_rgba (cr, 0, 0, 0, 0);
+	} else if (v->meta.trimmed) {
+		update_trimmed_frame(v, findex);
+		cairo_set_source_surface (cr, v->frame, 0, 0);
+	} else if (v->indexed.indices) {
+		update_indexed_frame(v, findex);
+		cairo_set_source_surface (cr, v->frame, 0, 0);
+	} else {
+		int fx = findex % v->columns;
+		int fy = findex / v->columns;
+		cairo_set_source_surface (cr, v->image, -v->h*fx, -v->h*fy);
+	}
+}
+
+// drop the scaled frames, they need to be redone for a new scale factor
+static void clear_scaled_frames(viewport *v) {
+	for (int i = 0; i <= v->s; i++) {
+		if (v->scaled[i]) cairo_surface_destroy(v->scaled[i]);
+		v->scaled[i] = NULL;
+	}
+	v->scaled_bytes = 0;
+}
+
+/** get frame findex scaled to rescale.c, scale it on first use,
+ *  returns NULL when the cache is full, the frame then get scaled on each redraw **/
+static cairo_surface_t *get_scaled_frame(viewport *v, int findex) {
+	if (v->scaled[findex]) return v->scaled[findex];
+	size_t bytes = (size_t)v->scaled_size * v->scaled_size * 4;
+	if (v->scaled_size < 1 || v->scaled_bytes + bytes > SCALED_CACHE_BYTES) return NULL;
+
+	cairo_surface_t *scaled = cairo_surface_create_similar(v->surface, CAIRO_CONTENT_COLOR_ALPHA,
+														   v->scaled_size, v->scaled_size);
+	cairo_t *cr = cairo_create(scaled);
+	cairo_scale (cr, v->rescale.c, v->rescale.c);
+	set_frame_source(v, cr, findex);
+	cairo_rectangle(cr,0, 0, v->h, v->h);
+	cairo_fill(cr);
+	cairo_destroy(cr);
+
+	v->scaled[findex] = scaled;
+	v->scaled_bytes += bytes;
+	return scaled;
+}
+
+// get sate of knob and calculate the frame index to show, with -i the blended step
+static int frame_index(viewport *v, controller *knob) {
+	double knobstate = (knob->adj.value - knob->adj.min_value) / (knob->adj.max_value - knob->adj.min_value);
+	if (v->blend && knob->tp == KNOB) return (int)(v->s * v->blend * knobstate);
+	return (int)(v->s * knobstate);
+}
+
+// position of the controller in the window
+static void controller_position(viewport *v, controller *knob, int *x, int *y) {
+	*x = (int)(knob->al.x * v->rescale.c + 0.5);
+	*y = (int)(knob->al.y * v->rescale.c + 0.5);
+}
+
+// the controller under the mouse pointer, or -1
+static int controller_at(viewport *v, int x, int y) {
+	for (int i = 0; i < v->count; i++) {
+		int cx, cy;
+		controller_position(v, &v->controllers[i], &cx, &cy);
+		if (x >= cx && x < cx + v->scaled_size && y >= cy && y < cy + v->scaled_size) return i;
+	}
+	return -1;
+}
+
+static int shm_failed = 0;
+
+static int shm_error_handler(Display* display, XErrorEvent* error) {
+	(void)display;
+	(void)error;
+	shm_failed = 1;
+	return 0;
+}
+
+static void shm_destroy(viewport *v) {
+	if (v->cr) cairo_destroy(v->cr);
+	if (v->surface) cairo_surface_destroy(v->surface);
+	v->cr = NULL;
+	v->surface = NULL;
+	XShmDetach(v->display, &v->shminfo);
+	XSync(v->display, False);
+	// the data belongs to the shared memory segment, not to the image
+	v->ximage->data = NULL;
+	XDestroyImage(v->ximage);
+	v->ximage = NULL;
+	shmdt(v->shminfo.shmaddr);
+}
+
+/** create a shared memory image of the window size and a cairo surface on it,
+ *  the server then read the pixels straight from our memory,
+ *  returns 0 when the display can't do that **/
+static int shm_create(viewport *v, int width, int height) {
+	int screen = DefaultScreen(v->display);
+	Visual *visual = DefaultVisual(v->display, screen);
+	int depth = DefaultDepth(v->display, screen);
+	int one = 1;
+	int byte_order = *(char*)&one ? LSBFirst : MSBFirst;
+	if (!XShmQueryExtension(v->display) || (depth != 24 && depth != 32) ||
+			ImageByteOrder(v->display) != byte_order || visual->red_mask != 0xff0000 ||
+			visual->green_mask != 0x00ff00 || visual->blue_mask != 0x0000ff) return 0;
+
+	v->ximage = XShmCreateImage(v->display, visual, depth, ZPixmap, NULL, &v->shminfo, width, height);
+	if (!v->ximage) return 0;
+	if (v->ximage->bits_per_pixel != 32) {
+		XDestroyImage(v->ximage);
+		v->ximage = NULL;
+		return 0;
+	}
+	v->shminfo.shmid = shmget(IPC_PRIVATE, v->ximage->bytes_per_line * height, IPC_CREAT | 0600);
+	if (v->shminfo.shmid < 0) {
+		XDestroyImage(v->ximage);
+		v->ximage = NULL;
+		return 0;
+	}
+	v->shminfo.shmaddr = v->ximage->data = (char*)shmat(v->shminfo.shmid, NULL, 0);
+	v->shminfo.readOnly = False;
+	if (v->shminfo.shmaddr == (char*)-1) {
+		shmctl(v->shminfo.shmid, IPC_RMID, NULL);
+		v->ximage->data = NULL;
+		XDestroyImage(v->ximage);
+		v->ximage = NULL;
+		return 0;
+	}
+
+	// attach fails on remote displays, catch the error instead of exiting
+	shm_failed = 0;
+	XErrorHandler handler = XSetErrorHandler(shm_error_handler);
+	XShmAttach(v->display, &v->shminfo);
+	XSync(v->display, False);
+	XSetErrorHandler(handler);
+	// the segment is removed once both sides detached
+	shmctl(v->shminfo.shmid, IPC_RMID, NULL);
+	if (shm_failed) {
+		shmdt(v->shminfo.shmaddr);
+		v->ximage->data = NULL;
+		XDestroyImage(v->ximage);
+		v->ximage = NULL;
+		return 0;
+	}
+
+	v->surface = cairo_image_surface_create_for_data((unsigned char*)v->ximage->data,
+		depth == 32 ? CAIRO_FORMAT_ARGB32 : CAIRO_FORMAT_RGB24, width, height, v->ximage->bytes_per_line);
+	v->cr = cairo_create(v->surface);
+	return 1;
+}
+
+// paint the stored frame findex at 0,0 with alpha
+static void paint_frame(viewport *v, int findex, double alpha) {
+	cairo_surface_t *scaled = get_scaled_frame(v, findex);
+	cairo_save (v->cr);
+	// draw knob image, a plain copy when it is already scaled
+	if (scaled) {
+		cairo_set_source_surface (v->cr, scaled, 0, 0);
+		cairo_rectangle(v->cr,0, 0, v->scaled_size, v->scaled_size);
+	} else {
+		// scale window to aspect ratio
+		cairo_scale (v->cr, v->rescale.c, v->rescale.c);
+		set_frame_source(v, v->cr, findex);
+		cairo_rectangle(v->cr,0, 0, v->h, v->h);
+	}
+	if (alpha >= 1.0) {
+		cairo_fill(v->cr);
+	} else {
+		cairo_clip(v->cr);
+		cairo_paint_with_alpha(v->cr, alpha);
+	}
+	cairo_restore (v->cr);
+}
+
+/** rotation strips, draw the base, the sprites turned to the angle of step
+ *  findex, the ring and the overlay, like paint_knob_state() does **/
+static void draw_rotation(viewport *v, int findex) {
+	const strip_rotation *r = &v->rotation;
+	double angle = r->angle + (double)findex / v->s * r->span;
+	cairo_t *cr = v->cr;
+	cairo_save (cr);
+	cairo_scale (cr, v->rescale.c, v->rescale.c);
+	cairo_rectangle(cr, 0, 0, v->h, v->h);
+	cairo_clip (cr);
+	cairo_set_source_surface (cr, v->image, 0, 0);
+	cairo_paint (cr);
+	for (int i = 0; i < r->sprites; i++) {
+		cairo_save (cr);
+		cairo_translate (cr, r->sprite_x[i], r->sprite_y[i]);
+		cairo_rotate (cr, angle - r->angle);
+		cairo_translate (cr, -r->sprite_x[i], -r->sprite_y[i]);
+		cairo_set_source_surface (cr, v->image, -v->h * (2 + i), 0);
+		cairo_rectangle(cr, 0, 0, v->h, v->h);
+		cairo_fill (cr);
+		cairo_restore (cr);
+	}
+
+	cairo_set_dash(cr, r->ring_dash, 2, 0);
+	cairo_set_line_width(cr, r->ring_width);
+	cairo_set_line_cap(cr, CAIRO_LINE_CAP_ROUND);
+	cairo_set_line_join(cr, CAIRO_LINE_JOIN_BEVEL);
+	cairo_set_source_rgb(cr, r->ring_background[0], r->ring_background[1], r->ring_background[2]);
+	cairo_arc (cr, r->ring_x, r->ring_y, r->ring_radius, r->ring_start, r->ring_start + r->ring_sweep);
+	cairo_stroke(cr);
+	if (angle > r->angle) {
+		cairo_set_source_rgb(cr, r->ring_foreground[0], r->ring_foreground[1], r->ring_foreground[2]);
+		cairo_arc (cr, r->ring_x, r->ring_y, r->ring_radius, r->ring_start, r->ring_start + angle - r->angle);
+		cairo_stroke(cr);
+	}
+	cairo_set_dash(cr, NULL, 0, 0);
+
+	cairo_set_source_surface (cr, v->image, -v->h, 0);
+	cairo_paint (cr);
+	cairo_restore (cr);
+}
+
+// draw frame findex of the controller at its place in the window
+static void draw_controller(viewport *v, controller *knob, int findex) {
+	int x, y;
+	controller_position(v, knob, &x, &y);
+	cairo_save (v->cr);
+	cairo_translate (v->cr, x, y);
+	if (v->rotate) {
+		draw_rotation(v, findex);
+	} else if (v->blend && knob->tp == KNOB && findex % v->blend) {
+		/** a step between two stored frames, mix them in a group, adding both
+		 *  with alpha 1-t and t is the linear blend, then draw it over the background **/
+		int f0 = findex / v->blend;
+		double t = (double)(findex % v->blend) / v->blend;
+		cairo_rectangle(v->cr, 0, 0, v->scaled_size, v->scaled_size);
+		cairo_clip (v->cr);
+		cairo_push_group (v->cr);
+		cairo_set_operator (v->cr, CAIRO_OPERATOR_ADD);
+		paint_frame(v, f0, 1.0 - t);
+		paint_frame(v, min(f0 + 1, v->s), t);
+		cairo_pop_group_to_source (v->cr);
+		cairo_paint (v->cr);
+	} else {
+		paint_frame(v, v->blend && knob->tp == KNOB ? findex / v->blend : findex, 1.0);
+	}
+	cairo_restore (v->cr);
+	knob->findex = findex;
+}
+
 // redraw the window
 static void _expose(viewport *v) {
-	// get sate of knob and calculate the frame index to show
-	double knobstate = (v->knob.adj.value - v->knob.adj.min_value) / (v->knob.adj.max_value - v->knob.adj.min_value);
-	int findex = (int)(v->s * knobstate);
-
-	// push and pop to avoid any flicker (offline drawing)
-	cairo_push_group (v->cr);
+	// push and pop to avoid any flicker (offline drawing),
+	// the shm image is offline already
+	double t0 = trace_begin();
+	double t = t0;
+	if (!v->use_shm) {
+		cairo_push_group (v->cr);
+		t = trace_next("push", t);
+	}
+	cairo_save (v->cr);
 
 	// scale window to user equest
 	cairo_scale (v->cr, v->rescale.x, v->rescale.y);
+	t = trace_next("scale", t);
 
 	// draw background
 	cairo_set_source_rgba (v->cr, 0.0, 0.0, 0.0, 1.0);
-	cairo_rectangle(v->cr,0, 0, v->h, v->h);
+	cairo_rectangle(v->cr,0, 0, v->panel_w, v->panel_h);
 	cairo_fill(v->cr);
+	cairo_restore (v->cr);
+	t = trace_next("fill", t);
 
-	// rescale to origion
-	cairo_scale (v->cr, v->rescale.x1, v->rescale.y1);
-	// scale window to aspect ratio
-	cairo_scale (v->cr, v->rescale.c, v->rescale.c);
+	for (int i = 0; i < v->count; i++)
+		draw_controller(v, &v->controllers[i], frame_index(v, &v->controllers[i]));
+	t = trace_next("controllers", t);
 
-	// draw knob image
-	cairo_set_source_surface (v->cr, v->image, -v->h*findex, 0);
-	cairo_rectangle(v->cr,0, 0, v->h, v->h);
-	cairo_fill(v->cr);
+	if (v->use_shm) {
+		// hand the back buffer to the server, wait until it's read before we draw again
+		cairo_surface_flush(v->surface);
+		XShmPutImage(v->display, v->win, v->gc, v->ximage, 0, 0, 0, 0, v->width, v->height, False);
+		XSync(v->display, False);
+		trace_end("put image", t);
+		trace_end("expose", t0);
+		return;
+	}
 
 	cairo_pop_group_to_source (v->cr);
+	t = trace_next("pop", t);
 
 	// finally paint to window
 	cairo_paint (v->cr);
+	trace_end("paint", t);
+	trace_end("expose", t0);
 }
 
-// send expose event to own window
-static void send_expose(Display* display,Window win) {
-	XEvent exppp;
-	memset(&exppp, 0, sizeof(exppp));
-	exppp.type = Expose;
-	exppp.xexpose.window = win;
-	XSendEvent(display,win,False,ExposureMask,&exppp);
-	// we don't need to flush the desktop in a single threated application
-	//XFlush(display);
+/** repaint only the rectangles of the controllers which show a new frame,
+ *  returns the number of repainted controllers **/
+static int expose_changed(viewport *v) {
+	int repainted = 0;
+	for (int i = 0; i < v->count; i++) {
+		controller *knob = &v->controllers[i];
+		int findex = frame_index(v, knob);
+		if (findex == knob->findex) continue;
+
+		int x, y;
+		controller_position(v, knob, &x, &y);
+		cairo_save (v->cr);
+		cairo_rectangle(v->cr, x, y, v->scaled_size, v->scaled_size);
+		cairo_clip (v->cr);
+		if (!v->use_shm) cairo_push_group (v->cr);
+		cairo_set_source_rgba (v->cr, 0.0, 0.0, 0.0, 1.0);
+		cairo_paint (v->cr);
+		draw_controller(v, knob, findex);
+		if (!v->use_shm) {
+			cairo_pop_group_to_source (v->cr);
+			cairo_paint (v->cr);
+		}
+		cairo_restore (v->cr);
+
+		if (v->use_shm) {
+			int w = min(v->scaled_size, v->width - x);
+			int h = min(v->scaled_size, v->height - y);
+			if (w > 0 && h > 0) {
+				cairo_surface_flush(v->surface);
+				XShmPutImage(v->display, v->win, v->gc, v->ximage, x, y, x, y, w, h, False);
+			}
+		}
+		repainted++;
+	}
+	if (v->use_shm && repainted) XSync(v->display, False);
+	return repainted;
+}
+
+// monotonic time in seconds
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// wait up to timeout seconds for X events, returns > 0 when events arrived
+static int wait_for_events(Display* display, double timeout) {
+	if (timeout <= 0.0) return 0;
+	int fd = ConnectionNumber(display);
+	fd_set fds;
+	FD_ZERO(&fds);
+	FD_SET(fd, &fds);
+	struct timeval tv;
+	tv.tv_sec = (long)timeout;
+	tv.tv_usec = (long)((timeout - tv.tv_sec) * 1e6);
+	return select(fd + 1, &fds, NULL, NULL, &tv);
+}
+
+/** called when the event queue is drained, repaint all when the
+ *  window got damaged or resized, else only the controllers with a new frame **/
+static void redraw(viewport *v) {
+	v->redraw = 0;
+	double start = now();
+	int repainted;
+	if (v->damaged || v->width != v->drawn_width || v->height != v->drawn_height) {
+		_expose(v);
+		repainted = v->count;
+		v->damaged = 0;
+		v->drawn_width = v->width;
+		v->drawn_height = v->height;
+	} else {
+		repainted = expose_changed(v);
+		if (!repainted) return;
+	}
+	v->last_draw = now();
+
+	if (v->stress) {
+		v->stress_redraws++;
+		v->stress_repainted += repainted;
+		v->stress_time += v->last_draw - start;
+		if (v->last_draw - v->stress_report >= 1.0) {
+			fprintf(stderr, "%i controllers: %i redraws/s, %.1f repainted per redraw, %.3f ms per redraw\n",
+					v->count, v->stress_redraws, (double)v->stress_repainted / v->stress_redraws,
+					v->stress_time * 1e3 / v->stress_redraws);
+			v->stress_redraws = v->stress_repainted = 0;
+			v->stress_time = 0.0;
+			v->stress_report = v->last_draw;
+		}
+	}
+}
+
+// stress mode, move every controller on its own sine wave
+static void animate(viewport *v, double t) {
+	for (int i = 0; i < v->count; i++) {
+		controller *knob = &v->controllers[i];
+		double speed = 0.2 + (i % 7) * 0.15;
+		double state = 0.5 + 0.5 * sin(t * speed * 2.0 * M_PI + i * 0.7);
+		if (knob->tp == SWITCH) state = (state > 0.5) ? 1.0 : 0.0;
+		knob->adj.value = state * (knob->adj.max_value - knob->adj.min_value) + knob->adj.min_value;
+	}
 }
 
 // mouse wheel scroll event
@@ -151,46 +622,573 @@ static void button1_event(controller *knob) {
 	knob->adj.value = value;
 }
 
+// a button press at x,y in the window, the controller below get the input
+static void button_press(viewport *v, int x, int y, unsigned int button) {
+	v->active = controller_at(v, x, y);
+	if (v->active < 0) return;
+	// save mouse position and knob value
+	v->pos_x = x;
+	v->pos_y = y;
+	v->start_value = v->controllers[v->active].adj.value;
+
+	switch(button) {
+		case  Button1:
+			// left button pressed
+			button1_event(&v->controllers[v->active]);
+			v->redraw = 1;
+		break;
+		case  Button4:
+			// mouse wheel scroll up
+			scroll_event(&v->controllers[v->active], 1);
+			v->redraw = 1;
+		break;
+		case Button5:
+			// mouse wheel scroll down
+			scroll_event(&v->controllers[v->active], -1);
+			v->redraw = 1;
+		break;
+		default:
+		break;
+	}
+}
+
+// mouse move to x,y while button1 is pressed
+static void button1_motion(viewport *v, int x, int y) {
+	// only the vertical move turn the knob
+	(void)x;
+	if (v->active < 0) return;
+	motion_event(&v->controllers[v->active], v->start_value, y, v->pos_y);
+	v->redraw = 1;
+}
+
+static void set_rescale(viewport *v);
+
 static void resize_event(viewport *v) {
 	// get new size
 	v->width = v->event.xconfigure.width;
 	v->height = v->event.xconfigure.height;
 	// resize cairo surface
-	cairo_xlib_surface_set_size( v->surface, v->width, v->height);
+	if (v->headless) {
+		if (v->width != cairo_image_surface_get_width(v->surface) ||
+				v->height != cairo_image_surface_get_height(v->surface)) {
+			cairo_destroy(v->cr);
+			cairo_surface_destroy(v->surface);
+			v->surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, v->width, v->height);
+			v->cr = cairo_create(v->surface);
+		}
+	} else if (v->use_shm) {
+		if (v->width != cairo_image_surface_get_width(v->surface) ||
+				v->height != cairo_image_surface_get_height(v->surface)) {
+			shm_destroy(v);
+			if (!shm_create(v, v->width, v->height)) {
+				// fall back to xlib
+				v->use_shm = 0;
+				v->surface = cairo_xlib_surface_create (v->display, v->win,
+					DefaultVisual(v->display, DefaultScreen (v->display)), v->width, v->height);
+				v->cr = cairo_create(v->surface);
+			}
+		}
+	} else {
+		cairo_xlib_surface_set_size( v->surface, v->width, v->height);
+	}
+	set_rescale(v);
+}
+
+// scale the panel to the window size
+static void set_rescale(viewport *v) {
 	// calculate scale factor
-	v->rescale.x  = (double)v->width/v->h;
-	v->rescale.y  = (double)v->height/v->h;
+	v->rescale.x  = (double)v->width/v->panel_w;
+	v->rescale.y  = (double)v->height/v->panel_h;
 	// calculate rescale factor
-	v->rescale.x1 = (double)v->h/v->width;
-	v->rescale.y1 = (double)v->h/v->height;
+	v->rescale.x1 = (double)v->panel_w/v->width;
+	v->rescale.y1 = (double)v->panel_h/v->height;
 	// calculate aspect ratio
 	v->rescale.c = (v->rescale.x < v->rescale.y) ? v->rescale.x : v->rescale.y;
 	// calculate rescale aspect ratio (ain't need here)
 	v->rescale.x2 =  v->rescale.x / v->rescale.c;
 	v->rescale.y2 = v->rescale.y / v->rescale.c;
+	// the scaled frames only stay valid when the scale factor is the same
+	double size = v->h * v->rescale.c;
+	int scaled_size = (int)size < size ? (int)size + 1 : (int)size;
+	if (scaled_size != v->scaled_size) {
+		clear_scaled_frames(v);
+		v->scaled_size = scaled_size;
+	}
+}
+
+// free the strip, the frames and the controllers
+static void free_strip(viewport *v) {
+	clear_scaled_frames(v);
+	free(v->scaled);
+	free(v->controllers);
+	if (v->image) cairo_surface_destroy(v->image);
+	if (v->frame) cairo_surface_destroy(v->frame);
+	strip_indexed_free(&v->indexed);
+	// the wrappers first, they point into the mapping
+	if (v->mapped) {
+		for (int i = 0; i < v->meta.frames; i++)
+			if (v->mapped[i]) cairo_surface_destroy(v->mapped[i]);
+		free(v->mapped);
+	}
+	strip_frames_close(&v->frames);
+	strip_meta_free(&v->meta);
+}
+
+/** -p replay, run a input trace against a image surface without a display
+ *  and report the redraw latency and the retained heap per event.
+ *  A trace hold one event per line, like knobview -R write them:
+ *  press x y button, motion x y (with button 1 down), resize width height.
+ *  drag, wheel, resize and all make a synthetic trace **/
+
+/** the heap in use before and after each event, a positive delta is memory
+ *  the event kept (caches, surfaces). What get allocated and freed in the
+ *  same redraw don't show up here, that is counted by the replay build **/
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+// large blocks like the surfaces are mmapped, they count as well
+static long long heap_in_use() {
+	struct mallinfo2 mi = mallinfo2();
+	return (long long)(mi.uordblks + mi.hblkhd);
+}
+#define HEAP_IN_USE() heap_in_use()
+#else
+#define HEAP_IN_USE() 0LL
+#endif
+
+/** the replay build, gcc -DREPLAY_ALLOCS ..., count the allocations and the
+ *  bytes allocated per event. This malloc take precedence over the one in
+ *  libc, so cairo and pixman get counted as well, but only while the replay
+ *  loop run. The normal knobview don't get it **/
+#if defined(REPLAY_ALLOCS) && defined(__GLIBC__)
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *p, size_t size);
+static int alloc_counting = 0;
+static size_t alloc_count = 0;
+static size_t alloc_bytes = 0;
+
+static void alloc_add(size_t size) {
+	if (!__atomic_load_n(&alloc_counting, __ATOMIC_RELAXED)) return;
+	__atomic_add_fetch(&alloc_count, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&alloc_bytes, size, __ATOMIC_RELAXED);
+}
+
+void *malloc(size_t size) {
+	alloc_add(size);
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+	alloc_add(n * size);
+	return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t size) {
+	alloc_add(size);
+	return __libc_realloc(p, size);
+}
+#define ALLOC_COUNTING(on) __atomic_store_n(&alloc_counting, on, __ATOMIC_RELAXED)
+#define ALLOC_COUNT() __atomic_load_n(&alloc_count, __ATOMIC_RELAXED)
+#define ALLOC_BYTES() __atomic_load_n(&alloc_bytes, __ATOMIC_RELAXED)
+#define ALLOC_COUNTED 1
+#else
+#define ALLOC_COUNTING(on)
+#define ALLOC_COUNT() 0
+#define ALLOC_BYTES() 0
+#define ALLOC_COUNTED 0
+#endif
+
+typedef enum {
+	EV_PRESS,
+	EV_MOTION,
+	EV_SCROLL,
+	EV_RESIZE,
+	EV_COUNT,
+} replay_type;
+
+static const char *replay_names[EV_COUNT] = {"press", "motion", "scroll", "resize"};
+
+typedef struct {
+	replay_type type;
+	int x;
+	int y;
+	unsigned int button;
+} replay_event;
+
+typedef struct {
+	replay_event *events;
+	int count;
+	int space;
+} replay_trace;
+
+typedef struct {
+	double *ms;
+	int count;
+	long long heap;
+	long long max_heap;
+	size_t allocs;
+	size_t max_allocs;
+	size_t bytes;
+} replay_stats;
+
+static void trace_add(replay_trace *t, replay_type type, int x, int y, unsigned int button) {
+	if (t->count == t->space) {
+		int space = t->space ? t->space * 2 : 256;
+		replay_event *e = (replay_event*)realloc(t->events, space * sizeof(replay_event));
+		// out of memory, the trace end here
+		if (!e) return;
+		t->events = e;
+		t->space = space;
+	}
+	t->events[t->count++] = (replay_event) {type, x, y, button};
+}
+
+// read a trace written by -R, returns non zero when the file can't be read
+static int trace_read(replay_trace *t, const char *trace_file) {
+	FILE *fp = fopen(trace_file, "r");
+	if (!fp) return 1;
+	char line[256];
+	char key[16];
+	int x, y;
+	unsigned int button;
+	while (fgets(line, sizeof(line), fp)) {
+		if (line[0] == '#' || sscanf(line, "%15s %i %i", key, &x, &y) != 3) continue;
+		if (strcmp(key, "press") == 0 && sscanf(line, "%*s %*i %*i %u", &button) == 1)
+			trace_add(t, (button == Button4 || button == Button5) ? EV_SCROLL : EV_PRESS, x, y, button);
+		else if (strcmp(key, "motion") == 0) trace_add(t, EV_MOTION, x, y, 0);
+		else if (strcmp(key, "resize") == 0 && x > 0 && y > 0) trace_add(t, EV_RESIZE, x, y, 0);
+	}
+	fclose(fp);
+	return 0;
+}
+
+// the synthetic traces, on the first 8 controllers
+static int trace_synthetic(replay_trace *t, viewport *v, const char *name) {
+	int all = strcmp(name, "all") == 0;
+	int known = 0;
+	int n = min(v->count, 8);
+	if (all || strcmp(name, "drag") == 0) {
+		// drag sweeps, from the middle to both ends and back
+		for (int i = 0; i < n; i++) {
+			int x, y;
+			controller_position(v, &v->controllers[i], &x, &y);
+			x += v->scaled_size / 2;
+			y += v->scaled_size / 2;
+			trace_add(t, EV_PRESS, x, y, Button1);
+			for (int d = 0; d <= 200; d += 2) trace_add(t, EV_MOTION, x, y - d, 0);
+			for (int d = 200; d >= -200; d -= 2) trace_add(t, EV_MOTION, x, y - d, 0);
+			for (int d = -200; d <= 0; d += 2) trace_add(t, EV_MOTION, x, y - d, 0);
+		}
+		known = 1;
+	}
+	if (all || strcmp(name, "wheel") == 0) {
+		// wheel bursts up and down
+		for (int i = 0; i < n; i++) {
+			int x, y;
+			controller_position(v, &v->controllers[i], &x, &y);
+			x += v->scaled_size / 2;
+			y += v->scaled_size / 2;
+			for (int k = 0; k < 100; k++) trace_add(t, EV_SCROLL, x, y, Button4);
+			for (int k = 0; k < 100; k++) trace_add(t, EV_SCROLL, x, y, Button5);
+		}
+		known = 1;
+	}
+	if (all || strcmp(name, "resize") == 0) {
+		// a resize storm, 60 % to 140 % of the window in a shuffled order
+		for (int k = 0; k < 200; k++) {
+			double f = 0.6 + 0.8 * ((k * 37) % 100) / 100.0;
+			trace_add(t, EV_RESIZE, max(1, (int)(v->width * f)), max(1, (int)(v->height * f)), 0);
+		}
+		// and back to the start size
+		trace_add(t, EV_RESIZE, v->width, v->height, 0);
+		known = 1;
+	}
+	return known ? 0 : 1;
+}
+
+static int compare_ms(const void *a, const void *b) {
+	double d = *(const double*)a - *(const double*)b;
+	return (d > 0) - (d < 0);
+}
+
+static double percentile(const double *sorted, int count, double p) {
+	int i = (int)(p * (count - 1) + 0.5);
+	return sorted[min(max(i, 0), count - 1)];
+}
+
+static int replay(viewport *v, const char *trace_name) {
+	replay_trace t = {NULL, 0, 0};
+	if (trace_synthetic(&t, v, trace_name) && trace_read(&t, trace_name)) {
+		fprintf(stderr, "%s: no such trace, use drag, wheel, resize, all or a file from -R\n", trace_name);
+		return 1;
+	}
+
+	// the first full redraw, as after the window got mapped
+	_expose(v);
+	v->damaged = 0;
+	v->drawn_width = v->width;
+	v->drawn_height = v->height;
+
+	replay_stats stats[EV_COUNT];
+	memset(stats, 0, sizeof(stats));
+	for (int i = 0; i < EV_COUNT; i++)
+		stats[i].ms = (double*)malloc((t.count + 1) * sizeof(double));
+
+	double total = now();
+	for (int i = 0; i < t.count; i++) {
+		replay_event *e = &t.events[i];
+		long long heap = HEAP_IN_USE();
+		size_t allocs = ALLOC_COUNT();
+		size_t bytes = ALLOC_BYTES();
+		ALLOC_COUNTING(1);
+		double start = now();
+		switch (e->type) {
+			case EV_PRESS:
+			case EV_SCROLL:
+				button_press(v, e->x, e->y, e->button);
+			break;
+			case EV_MOTION:
+				button1_motion(v, e->x, e->y);
+			break;
+			case EV_RESIZE:
+				v->event.xconfigure.width = e->x;
+				v->event.xconfigure.height = e->y;
+				resize_event(v);
+				v->redraw = 1;
+			break;
+			default:
+			break;
+		}
+		// redraw at once, the latency of each event is what we are after
+		if (v->redraw) redraw(v);
+		v->redraw = 0;
+		replay_stats *s = &stats[e->type];
+		s->ms[s->count++] = (now() - start) * 1e3;
+		ALLOC_COUNTING(0);
+		allocs = ALLOC_COUNT() - allocs;
+		s->allocs += allocs;
+		if (allocs > s->max_allocs) s->max_allocs = allocs;
+		s->bytes += ALLOC_BYTES() - bytes;
+		heap = HEAP_IN_USE() - heap;
+		s->heap += heap;
+		if (heap > s->max_heap) s->max_heap = heap;
+	}
+	total = now() - total;
+
+	fprintf(stdout, "%i controllers, %i events in %.1f ms\n", v->count, t.count, total * 1e3);
+	fprintf(stdout, "event    count   p50 ms   p90 ms   p99 ms   max ms  retained B/event  max retained B%s\n",
+			ALLOC_COUNTED ? "  allocs/event  max allocs  KiB alloc/event" : "");
+	for (int i = 0; i < EV_COUNT; i++) {
+		replay_stats *s = &stats[i];
+		if (s->count) {
+			qsort(s->ms, s->count, sizeof(double), compare_ms);
+			fprintf(stdout, "%-6s %7i %8.3f %8.3f %8.3f %8.3f %17.1f %15lld", replay_names[i], s->count,
+					percentile(s->ms, s->count, 0.5), percentile(s->ms, s->count, 0.9),
+					percentile(s->ms, s->count, 0.99), s->ms[s->count - 1],
+					(double)s->heap / s->count, s->max_heap);
+			if (ALLOC_COUNTED)
+				fprintf(stdout, " %13.1f %11zu %16.1f", (double)s->allocs / s->count, s->max_allocs,
+						s->bytes / 1024.0 / s->count);
+			fprintf(stdout, "\n");
+		}
+		free(s->ms);
+	}
+#if !defined(__GLIBC__) || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 33)
+	fprintf(stdout, "the retained heap is only measured with glibc 2.33 or newer\n");
+#endif
+	if (!ALLOC_COUNTED)
+		fprintf(stdout, "allocations are not measured, build with -DREPLAY_ALLOCS (glibc) to count them\n");
+	free(t.events);
+	return 0;
 }
 
 int main(int argc, char* argv[])
 {
 	viewport v;
-	v.display = XOpenDisplay(NULL);
+	v.count = 1;
+	v.stress = 0;
+	v.blend = 0;
+	const char *replay_trace = NULL;
+	const char *record_file = NULL;
+	int opt;
+	trace_init("knobview");
+	while ((opt = getopt(argc, argv, "n:si:p:R:")) != -1) {
+		switch (opt) {
+			case 'n':
+				// number of controllers on the panel
+				v.count = max(1, atoi(optarg));
+			break;
+			case 's':
+				// animate all controllers and report the redraw cost
+				v.stress = 1;
+			break;
+			case 'i':
+				// blend N steps between two stored frames, for strips with less frames
+				v.blend = max(0, atoi(optarg));
+				if (v.blend == 1) v.blend = 0;
+			break;
+			case 'p':
+				// replay a trace without a display: drag, wheel, resize, all or a -R file
+				replay_trace = optarg;
+			break;
+			case 'R':
+				// record the input to a trace file
+				record_file = optarg;
+			break;
+			default:
+				fprintf(stdout, "usage: %s [-n controllers] [-s] [-i steps] [-p trace] [-R trace_file]\n",
+						basename(argv[0]));
+				return 1;
+		}
+	}
+
+	v.headless = replay_trace != NULL;
+	v.record = NULL;
 
-	v.image = cairo_image_surface_create_from_png ("./knob.png");
-	v.w = cairo_image_surface_get_width (v.image);
-	v.h = cairo_image_surface_get_height (v.image);
+	// a -f frames container is only mapped, the frames get touched when they are drawn
+	// palette strips are kept as they are, all others get expanded by cairo
+	v.image = NULL;
+	v.w = v.h = 0;
+	memset(&v.indexed, 0, sizeof(strip_indexed));
+	double t = trace_begin();
+	if (strip_frames_open("./knob.frames", &v.frames) == 0) {
+		v.w = v.frames.size * v.frames.frames;
+		v.h = v.frames.size;
+	} else if (strip_indexed_load("./knob.png", &v.indexed) == 0) {
+		v.w = v.indexed.width;
+		v.h = v.indexed.height;
+	} else {
+		v.image = cairo_image_surface_create_from_png ("./knob.png");
+	}
+	// a -f qoi strip load faster
+	if (v.image && cairo_surface_status(v.image) != CAIRO_STATUS_SUCCESS) {
+		cairo_surface_t *qoi = strip_qoi_load("./knob.qoi");
+		if (qoi) {
+			cairo_surface_destroy(v.image);
+			v.image = qoi;
+		}
+	}
+	trace_end("load", t);
+	if (v.image) {
+		v.w = cairo_image_surface_get_width (v.image);
+		v.h = cairo_image_surface_get_height (v.image);
+	}
 	if (!v.w ||!v.h) {
-		XCloseDisplay(v.display);
-		fprintf(stderr, "./knob.png not found\n");
+		fprintf(stderr, "./knob.frames, ./knob.png or ./knob.qoi not found\n");
 		return 1;
 	}
-	v.s = (v.w/v.h)-1;
-	fprintf(stderr, "width %i height %i steps %i\n", v.w,v.h,v.s);
+	// a knobmake -r strip, the png hold the layers, the knob turn in ROTATE_STEPS steps
+	v.rotate = v.image && strip_rotation_read("./knob.rotate", &v.rotation) == 0 &&
+			   v.rotation.size == v.h && v.w == v.h * v.rotation.layers;
+	if (v.rotate) v.blend = 0;
+	// a single row strip when there is no ./knob.meta, the container know its frames
+	strip_meta_init(&v.meta, v.h, v.w/v.h);
+	// a stale ./knob.meta which don't fit the image would read outside of it
+	int meta = !v.frames.map && !v.rotate && strip_meta_read("./knob.meta", &v.meta) == 0;
+	if (meta && strip_meta_check(&v.meta, v.w, v.h)) {
+		fprintf(stderr, "./knob.meta don't fit the %ix%i strip, ignored\n", v.w, v.h);
+		meta = 0;
+	}
+	if (meta) {
+		v.h = v.meta.size;
+	} else {
+		strip_meta_free(&v.meta);
+		strip_meta_init(&v.meta, v.h, v.w/v.h);
+	}
+	v.columns = v.meta.columns;
+	v.s = v.rotate ? ROTATE_STEPS : v.meta.frames-1;
+
+	// clear_scaled_frames() walk all steps, rotation strips have more steps then layers
+	v.scaled = (cairo_surface_t**)calloc(v.s + 1, sizeof(cairo_surface_t*));
+	v.scaled_size = 0;
+	v.scaled_bytes = 0;
+	v.mapped = v.frames.map ? (cairo_surface_t**)calloc(v.meta.frames, sizeof(cairo_surface_t*)) : NULL;
+
+	// trimmed palette strips are expanded, the frames are copied in pieces
+	if (v.indexed.indices && v.meta.trimmed) {
+		v.image = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, v.indexed.width, v.indexed.height);
+		strip_indexed_expand(&v.indexed, 0, 0, v.indexed.width, v.indexed.height,
+							 cairo_image_surface_get_data(v.image), cairo_image_surface_get_stride(v.image));
+		cairo_surface_mark_dirty(v.image);
+		strip_indexed_free(&v.indexed);
+	}
+
+	// trimmed strips, start with the base frame
+	v.frame = NULL;
+	v.findex = 0;
+	if (v.indexed.indices) {
+		v.frame = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, v.h, v.h);
+		v.findex = -1;
+	}
+	if (v.meta.trimmed) {
+		v.frame = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, v.h, v.h);
+		cairo_t *cr = cairo_create(v.frame);
+		cairo_set_source_surface(cr, v.image, 0, 0);
+		cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+		cairo_paint(cr);
+		cairo_destroy(cr);
+	}
+	fprintf(stderr, "width %i height %i steps %i columns %i\n", v.w,v.h,v.s,v.columns);
+
+	// lay out the controllers in a near square grid
+	int columns = 1;
+	while (columns * columns < v.count) columns++;
+	v.panel_w = v.h * columns;
+	v.panel_h = v.h * ((v.count + columns - 1) / columns);
+	v.controllers = (controller*)calloc(v.count, sizeof(controller));
+	for (int i = 0; i < v.count; i++) {
+		controller *knob = &v.controllers[i];
+		*knob = (controller) {{0.5,0.5,0.0,1.0, 0.01},{(i % columns) * v.h, (i / columns) * v.h, v.h, v.h}};
+		knob->tp = (v.s<2) ? SWITCH : KNOB;
+		knob->adj.step = (knob->tp == SWITCH) ? 1.0 : 0.01;
+		knob->findex = -1;
+	}
+	v.active = 0;
+
+	// start with a window that fits on the screen
+	double scale = min(1.0, 1200.0 / max(v.panel_w, v.panel_h));
+	int win_w = max(1, (int)(v.panel_w * scale));
+	int win_h = max(1, (int)(v.panel_h * scale));
+
+	v.redraw = 0;
+	v.damaged = 1;
+	v.drawn_width = v.drawn_height = 0;
+	v.last_draw = 0.0;
+	v.stress_redraws = v.stress_repainted = 0;
+	v.stress_time = 0.0;
+	v.stress_report = now();
+	v.cr = NULL;
+	v.surface = NULL;
+	v.ximage = NULL;
+	v.width = win_w;
+	v.height = win_h;
+	v.use_shm = 0;
 
-	v.knob = (controller) {{0.5,0.5,0.0,1.0, 0.01},{0,0,v.w,v.h}};
-	v.knob.tp = (v.s<2) ? SWITCH : KNOB;
-	v.knob.adj.step = (v.knob.tp == SWITCH) ? 1.0 : 0.01;
+	int ret = 0;
+	if (v.headless) {
+		v.display = NULL;
+		v.surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, win_w, win_h);
+		v.cr = cairo_create(v.surface);
+		set_rescale(&v);
+		ret = replay(&v, replay_trace);
+		cairo_destroy(v.cr);
+		cairo_surface_destroy(v.surface);
+		free_strip(&v);
+		return ret;
+	}
+
+	v.display = XOpenDisplay(NULL);
+	if (!v.display) {
+		fprintf(stderr, "can't open the display, use -p to replay a trace without one\n");
+		free_strip(&v);
+		return 1;
+	}
+	if (record_file) {
+		v.record = fopen(record_file, "w");
+		if (!v.record) fprintf(stderr, "could not open %s\n", record_file);
+		else fprintf(v.record, "# knobview trace, replay it with -p %s\n", record_file);
+	}
 
-	v.win = XCreateWindow(v.display, DefaultRootWindow(v.display), 0, 0, v.h,v.h, 0,
+	v.win = XCreateWindow(v.display, DefaultRootWindow(v.display), 0, 0, win_w, win_h, 0,
 						CopyFromParent, InputOutput, CopyFromParent, CopyFromParent, 0);
 
 	v.event_mask = StructureNotifyMask|ExposureMask|KeyPressMask 
@@ -202,73 +1200,76 @@ int main(int argc, char* argv[])
 	v.wm_delete_window = XInternAtom(v.display, "WM_DELETE_WINDOW", 0);
 	XSetWMProtocols(v.display, v.win, &v.wm_delete_window, 1);
 
-	v.surface = cairo_xlib_surface_create (v.display, v.win,DefaultVisual(v.display, DefaultScreen (v.display)), v.h, v.h);
-	v.cr = cairo_create(v.surface);
+	v.gc = XCreateGC(v.display, v.win, 0, NULL);
+	v.use_shm = shm_create(&v, win_w, win_h);
+	if (!v.use_shm) {
+		v.surface = cairo_xlib_surface_create (v.display, v.win,DefaultVisual(v.display, DefaultScreen (v.display)), win_w, win_h);
+		v.cr = cairo_create(v.surface);
+	}
+	fprintf(stderr, "present with %s\n", v.use_shm ? "MIT-SHM" : "xlib");
+	set_rescale(&v);
 
 	XMapWindow(v.display, v.win);
 
 	int keep_running = 1;
 
+	v.redraw = v.stress;
+
 	while (keep_running) {
+		// all pending input is handled, repaint once when a display refresh has passed
+		if (v.redraw && !XPending(v.display)) {
+			if (wait_for_events(v.display, v.last_draw + FRAME_TIME - now()) <= 0) {
+				if (v.stress) animate(&v, now());
+				redraw(&v);
+				v.redraw = v.stress;
+			}
+			continue;
+		}
 		XNextEvent(v.display, &v.event);
 
 		switch(v.event.type) {
 			case ConfigureNotify:
 				// configure event, we only check for resize events here
+				if (v.record && (v.event.xconfigure.width != v.width || v.event.xconfigure.height != v.height))
+					fprintf(v.record, "resize %i %i\n", v.event.xconfigure.width, v.event.xconfigure.height);
 				resize_event(&v);
+				v.redraw = 1;
 			break;
 			case Expose:
 				// only redraw on the last expose event
 				if (v.event.xexpose.count == 0) {
-					_expose(&v);
+					v.damaged = 1;
+					v.redraw = 1;
 				}
 			break;
 			case ButtonPress:
-				// save mouse position and knob value
-				v.pos_x = v.event.xbutton.x;
-				v.pos_y = v.event.xbutton.y;
-				v.start_value = v.knob.adj.value;
-
-				switch(v.event.xbutton.button) {
-					case  Button1:
-						// left button pressed
-						button1_event(&v.knob);
-						send_expose(v.display,v.win);
-					break;
-					case  Button4:
-						// mouse wheel scroll up
-						scroll_event(&v.knob, 1);
-						send_expose(v.display,v.win);
-					break;
-					case Button5:
-						// mouse wheel scroll down
-						scroll_event(&v.knob, -1);
-						send_expose(v.display,v.win);
-					break;
-					default:
-					break;
-				}
+				// the controller under the mouse get the input
+				if (v.record)
+					fprintf(v.record, "press %i %i %u\n", v.event.xbutton.x, v.event.xbutton.y, v.event.xbutton.button);
+				button_press(&v, v.event.xbutton.x, v.event.xbutton.y, v.event.xbutton.button);
 			break;
 			case MotionNotify:
 				// mouse move while button1 is pressed
-				if(v.event.xmotion.state & Button1Mask) {
-					motion_event(&v.knob, v.start_value, v.event.xmotion.y, v.pos_y);
-					send_expose(v.display,v.win);
+				if (v.event.xmotion.state & Button1Mask) {
+					if (v.record) fprintf(v.record, "motion %i %i\n", v.event.xmotion.x, v.event.xmotion.y);
+					button1_motion(&v, v.event.xmotion.x, v.event.xmotion.y);
 				}
 			break;
 			case KeyPress:
+				// keys go to the last clicked controller
+				if (v.active < 0) break;
 				if (v.event.xkey.keycode == XKeysymToKeycode(v.display,XK_Up)) {
-					scroll_event(&v.knob, 1);
-					send_expose(v.display,v.win);
+					scroll_event(&v.controllers[v.active], 1);
+					v.redraw = 1;
 				} else if (v.event.xkey.keycode == XKeysymToKeycode(v.display,XK_Right)) {
-					scroll_event(&v.knob, 1);
-					send_expose(v.display,v.win);
+					scroll_event(&v.controllers[v.active], 1);
+					v.redraw = 1;
 				} else if (v.event.xkey.keycode == XKeysymToKeycode(v.display,XK_Down)) {
-					scroll_event(&v.knob, -1);
-					send_expose(v.display,v.win);
+					scroll_event(&v.controllers[v.active], -1);
+					v.redraw = 1;
 				} else if (v.event.xkey.keycode == XKeysymToKeycode(v.display,XK_Left)) {
-					scroll_event(&v.knob, -1);
-					send_expose(v.display,v.win);
+					scroll_event(&v.controllers[v.active], -1);
+					v.redraw = 1;
 				}
 			break;
 			case ClientMessage:
@@ -281,10 +1282,16 @@ int main(int argc, char* argv[])
 		}
 	}
 
-	cairo_destroy(v.cr);
-	cairo_surface_destroy(v.surface);
-	cairo_surface_destroy(v.image);
+	if (v.use_shm) {
+		shm_destroy(&v);
+	} else {
+		cairo_destroy(v.cr);
+		cairo_surface_destroy(v.surface);
+	}
+	XFreeGC(v.display, v.gc);
+	free_strip(&v);
+	if (v.record) fclose(v.record);
 	XDestroyWindow(v.display, v.win);
 	XCloseDisplay(v.display);
-	return 0;
+	return ret;
 }
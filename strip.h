@@ -0,0 +1,729 @@
+#ifndef STRIP_H
+#define STRIP_H
+
+#include <cairo.h>
+#include <cairo-svg.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "knob_trace.h"
+#include "strip_cache.h"
+#include "strip_carray.h"
+#include "strip_frames.h"
+#include "strip_index.h"
+#include "strip_meta.h"
+#include "strip_png.h"
+#include "strip_qoi.h"
+#include "strip_scale.h"
+
+// frame loop shared by knob_make.c and switch_make.c
+
+// draw a single frame for knobstate in the range 0 . . 1
+typedef void (*paint_func)(cairo_t *cr, int knob_size, int knob_offset, double knobstate);
+
+// output formats, could be or'ed together
+typedef enum {
+	STRIP_PNG = 1,
+	STRIP_SVG = 2,
+	STRIP_QOI = 4,
+	STRIP_FRAMES = 8,
+	STRIP_C = 16,
+} strip_format;
+
+// the formats written from the pixels of a image surface
+#define STRIP_RASTER (STRIP_PNG | STRIP_QOI | STRIP_FRAMES | STRIP_C)
+
+#define STRIP_MAX_SCALES 8
+
+// settings shared by all strips of a run
+typedef struct {
+	int threads;
+	int formats;
+	// frames per row, 0 for a near square grid, -1 for a single row
+	int columns;
+	// store only the changed part of each frame
+	int trim;
+	// write the strip at these scales, derived from one render at the largest
+	double scales[STRIP_MAX_SCALES];
+	int nscales;
+	// render each scale natively as well and compare
+	int verify;
+	// zlib level for the chunked png writer and the .frames container,
+	// -1 use cairo's writer and store the frames raw
+	int zlevel;
+	// write a palette png with this many colors, 0 for RGBA
+	int colors;
+	int dither;
+	// skip strips whose name.stamp match, see strip_cache.h
+	int cache;
+} strip_options;
+
+// the getopt string for the options handled by strip_parse_option()
+#define STRIP_OPTIONS "j:f:c:tx:vz:q:dk"
+#define STRIP_USAGE "[-j threads] [-f png,svg,qoi,frames,c|both] [-z level] [-q colors [-d]] [-c columns] [-t] [-x scales [-v]] [-k]"
+
+typedef struct {
+	paint_func paint;
+	int knob_size;
+	int knob_frames;
+	int knob_offset;
+	// the size given to paint, drawn with the scale factor to knob_size
+	int paint_size;
+	double scale;
+	int threads;
+	int formats;
+	strip_meta layout;
+
+	// the strip, frames get composited into it strictly in frame order
+	cairo_t *cr;
+	int next;
+	// next frame to hand out to a worker
+	int claimed;
+	pthread_mutex_t lock;
+	pthread_cond_t turn;
+	// the pixels of a image strip, frames are drawn straight into it, NULL for svg
+	unsigned char *data;
+	int stride;
+	// ARGB32, or A8 for the coverage masks of knobmake -m
+	cairo_format_t format;
+} strip_job;
+
+// number of worker threads to use for "-j 0"
+static inline int strip_cpu_count() {
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return (n > 0) ? (int)n : 1;
+}
+
+// comma separated list of "png", "svg", "qoi", "frames", "c" or "both", returns 0 for unknown formats
+static inline int strip_parse_format(const char *name) {
+	int formats = 0;
+	while (*name) {
+		size_t len = strcspn(name, ",");
+		if (len == 3 && strncmp(name, "png", 3) == 0) formats |= STRIP_PNG;
+		else if (len == 3 && strncmp(name, "svg", 3) == 0) formats |= STRIP_SVG;
+		else if (len == 3 && strncmp(name, "qoi", 3) == 0) formats |= STRIP_QOI;
+		else if (len == 6 && strncmp(name, "frames", 6) == 0) formats |= STRIP_FRAMES;
+		else if (len == 1 && name[0] == 'c') formats |= STRIP_C;
+		else if (len == 4 && strncmp(name, "both", 4) == 0) formats |= STRIP_PNG | STRIP_SVG;
+		else return 0;
+		name += len;
+		if (*name == ',') name++;
+	}
+	return formats;
+}
+
+static inline void strip_options_init(strip_options *o) {
+	o->threads = 1;
+	o->formats = STRIP_PNG | STRIP_SVG;
+	o->columns = -1;
+	o->trim = 0;
+	o->nscales = 0;
+	o->verify = 0;
+	o->zlevel = -1;
+	o->colors = 0;
+	o->dither = 0;
+	o->cache = 0;
+}
+
+static inline double strip_now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// handle one of the STRIP_OPTIONS, returns 0 for unknown options or bad values
+static inline int strip_parse_option(strip_options *o, int opt, const char *arg) {
+	switch (opt) {
+		case 'j':
+			// render frames on N threads, 0 use all cpu's
+			o->threads = atoi(arg);
+			if (o->threads <= 0) o->threads = strip_cpu_count();
+		break;
+		case 'f':
+			// output formats png, svg, qoi, frames, c or both (png and svg)
+			o->formats = strip_parse_format(arg);
+			if (!o->formats) return 0;
+		break;
+		case 'z':
+			// png compression level 0 - 9, deflated in chunks on all -j threads,
+			// and deflate each frame in the .frames container
+			o->zlevel = atoi(arg);
+			if (o->zlevel < 0 || o->zlevel > 9) return 0;
+		break;
+		case 'q':
+			// reduce the png to a palette of 2 - 256 colors
+			o->colors = atoi(arg);
+			if (o->colors < 2 || o->colors > 256) return 0;
+		break;
+		case 'd':
+			// dither the palette png
+			o->dither = 1;
+		break;
+		case 'k':
+			// build cache, only render strips which changed since the last run
+			o->cache = 1;
+		break;
+		case 'c':
+			// lay out frames in rows of N columns, 0 for a near square grid
+			o->columns = atoi(arg);
+			if (o->columns < 0) return 0;
+		break;
+		case 't':
+			// trim the frames against the first one
+			o->trim = 1;
+		break;
+		case 'x': {
+			// comma separated list of scales, like 1,1.5,2,3
+			char *end;
+			o->nscales = 0;
+			do {
+				double scale = strtod(arg, &end);
+				if (end == arg || scale <= 0.0 || o->nscales == STRIP_MAX_SCALES) return 0;
+				o->scales[o->nscales++] = scale;
+				arg = end + 1;
+			} while (*end == ',');
+			if (*end) return 0;
+		}
+		break;
+		case 'v':
+			// compare the downsampled strips with native rendering
+			o->verify = 1;
+		break;
+		default:
+			return 0;
+	}
+	return 1;
+}
+
+/** only svg output needs the vector recording, a png only run
+ *  use plain ARGB32 image surfaces for the frames and the strip **/
+static inline cairo_surface_t *strip_surface(const char *svg_file, int width, int height, int formats) {
+	if (formats & STRIP_SVG)
+		return cairo_svg_surface_create(svg_file, width, height);
+	return cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+}
+
+// paint frame i to crf, scaled when paint_size differ from the frame size
+static inline void strip_paint_frame(strip_job *job, cairo_t *crf, int i) {
+	double knobstate = (double)((double)i/ job->knob_frames);
+	if (job->scale != 1.0) {
+		cairo_save(crf);
+		cairo_scale(crf, job->scale, job->scale);
+		job->paint(crf, job->paint_size, job->knob_offset, knobstate);
+		cairo_restore(crf);
+	} else {
+		job->paint(crf, job->knob_size, job->knob_offset, knobstate);
+	}
+}
+
+/** image strips: frames don't overlap, so each frame get a surface on its
+ *  part of the strip pixels (same stride) and is drawn in place. The strip is
+ *  cleared on create, so there is nothing to copy or clear and the workers
+ *  don't need to wait for each other **/
+static inline void strip_worker_inplace(strip_job *job) {
+	for (;;) {
+		pthread_mutex_lock(&job->lock);
+		int i = job->claimed++;
+		pthread_mutex_unlock(&job->lock);
+		if (i >= job->knob_frames) break;
+
+		int x, y;
+		strip_meta_frame(&job->layout, i, &x, &y);
+		double t = trace_begin();
+		int bpp = (job->format == CAIRO_FORMAT_A8) ? 1 : 4;
+		cairo_surface_t *frame = cairo_image_surface_create_for_data(job->data + (size_t)y * job->stride + x * bpp,
+									job->format, job->knob_size, job->knob_size, job->stride);
+		cairo_t *crf = cairo_create(frame);
+		strip_paint_frame(job, crf, i);
+		cairo_destroy(crf);
+		cairo_surface_finish(frame);
+		cairo_surface_destroy(frame);
+		trace_end("frame", t);
+	}
+}
+
+/** render frames until all are claimed, on a svg strip each worker use its
+ *  own frame surface and composite it into the strip in frame order **/
+static inline void *strip_worker_run(void *arg) {
+	strip_job *job = (strip_job*)arg;
+	if (job->data) {
+		strip_worker_inplace(job);
+		return NULL;
+	}
+	cairo_surface_t *frame = strip_surface(NULL, job->knob_size, job->knob_size, job->formats);
+	cairo_t *crf = cairo_create(frame);
+
+	for (;;) {
+		pthread_mutex_lock(&job->lock);
+		int i = job->claimed++;
+		pthread_mutex_unlock(&job->lock);
+		if (i >= job->knob_frames) break;
+
+		double t = trace_begin();
+		strip_paint_frame(job, crf, i);
+		t = trace_next("frame", t);
+
+		// wait until all previous frames are in the strip
+		pthread_mutex_lock(&job->lock);
+		while (job->next != i)
+			pthread_cond_wait(&job->turn, &job->lock);
+		t = trace_next("wait", t);
+		int x, y;
+		strip_meta_frame(&job->layout, i, &x, &y);
+		cairo_set_source_surface(job->cr, frame, x, y);
+		cairo_paint(job->cr);
+		cairo_set_operator(crf,CAIRO_OPERATOR_CLEAR);
+		cairo_paint(crf);
+		cairo_set_operator(crf,CAIRO_OPERATOR_OVER);
+		trace_end("composite", t);
+		job->next++;
+		pthread_cond_broadcast(&job->turn);
+		pthread_mutex_unlock(&job->lock);
+	}
+
+	cairo_destroy(crf);
+	cairo_surface_destroy(frame);
+	return NULL;
+}
+
+/** draw all frames into the strip context cr at the place given by layout,
+ *  paint get paint_size and draw scaled by scale to the layout size,
+ *  with threads > 1 the frames get rendered in parallel,
+ *  the result is the same as from the serial loop.
+ *  A ARGB32 or A8 image strip must be clear, the frames are drawn straight into
+ *  its pixels and the transformation of cr is not used **/
+static inline void strip_render_scaled(cairo_t *cr, paint_func paint, const strip_meta *layout,
+								int paint_size, int knob_offset, double scale, const strip_options *o) {
+	int threads = o->threads;
+	if (threads > layout->frames) threads = layout->frames;
+	if (threads < 1) threads = 1;
+	strip_job job = {
+		.paint = paint,
+		.knob_size = layout->size,
+		.knob_frames = layout->frames,
+		.knob_offset = knob_offset,
+		.paint_size = paint_size,
+		.scale = scale,
+		.threads = threads,
+		.formats = o->formats,
+		.layout = *layout,
+		.cr = cr,
+		.next = 0,
+		.claimed = 0,
+		.data = NULL,
+		.stride = 0,
+	};
+	pthread_mutex_init(&job.lock, NULL);
+	pthread_cond_init(&job.turn, NULL);
+	cairo_surface_t *target = cairo_get_target(cr);
+	job.format = (cairo_surface_get_type(target) == CAIRO_SURFACE_TYPE_IMAGE) ?
+				 cairo_image_surface_get_format(target) : CAIRO_FORMAT_INVALID;
+	if (job.format == CAIRO_FORMAT_ARGB32 || job.format == CAIRO_FORMAT_A8) {
+		cairo_surface_flush(target);
+		job.data = cairo_image_surface_get_data(target);
+		job.stride = cairo_image_surface_get_stride(target);
+	}
+
+	// frames get claimed in order, so running with fewer workers is fine
+	pthread_t workers[threads];
+	int started = 0;
+	for (int t = 1; t < threads; t++) {
+		if (pthread_create(&workers[started], NULL, strip_worker_run, &job) != 0) {
+			fprintf(stderr, "failed to start worker thread %i\n", t);
+			break;
+		}
+		started++;
+	}
+	// the main thread works on the frames as well
+	double t0 = trace_begin();
+	strip_worker_run(&job);
+	for (int t = 0; t < started; t++)
+		pthread_join(workers[t], NULL);
+	if (job.data) cairo_surface_mark_dirty(target);
+	trace_end("frame loop", t0);
+
+	pthread_cond_destroy(&job.turn);
+	pthread_mutex_destroy(&job.lock);
+}
+
+static inline void strip_render(cairo_t *cr, paint_func paint, const strip_meta *layout,
+						 int knob_offset, const strip_options *o) {
+	strip_render_scaled(cr, paint, layout, layout->size, knob_offset, 1.0, o);
+}
+
+// bounding box of the pixels in frame which differ from base, w = 0 when they are equal
+static inline void strip_diff_rect(const unsigned char *data, int stride, int fx, int fy, int size, strip_rect *r) {
+	int x0 = size, y0 = size, x1 = -1, y1 = -1;
+	for (int y = 0; y < size; y++) {
+		const uint32_t *base = (const uint32_t*)(data + y * stride);
+		const uint32_t *frame = (const uint32_t*)(data + (fy + y) * stride) + fx;
+		for (int x = 0; x < size; x++) {
+			if (base[x] == frame[x]) continue;
+			if (x < x0) x0 = x;
+			if (x > x1) x1 = x;
+			if (y < y0) y0 = y;
+			y1 = y;
+		}
+	}
+	r->x = (x1 < 0) ? 0 : x0;
+	r->y = (x1 < 0) ? 0 : y0;
+	r->w = (x1 < 0) ? 0 : x1 - x0 + 1;
+	r->h = (x1 < 0) ? 0 : y1 - y0 + 1;
+}
+
+/** trim the rendered strip image against its first frame,
+ *  returns a new image holding the base frame at 0,0 followed by
+ *  the changed part of every frame, packed in shelfs, and fill layout->rects **/
+static inline cairo_surface_t *strip_trim(cairo_surface_t *strip, strip_meta *layout) {
+	int size = layout->size;
+	unsigned char *data = cairo_image_surface_get_data(strip);
+	int stride = cairo_image_surface_get_stride(strip);
+
+	// the grid of frames + base is the worst case, so the packed image always fits in it
+	strip_meta grid;
+	strip_meta_init(&grid, size, layout->frames + 1);
+	strip_meta_layout(&grid, 0);
+	int width = size * grid.columns;
+
+	layout->rects = (strip_rect*)calloc(layout->frames, sizeof(strip_rect));
+	int x = size, y = 0, shelf = size;
+	for (int i = 0; i < layout->frames; i++) {
+		strip_rect *r = &layout->rects[i];
+		int fx, fy;
+		strip_meta_frame(layout, i, &fx, &fy);
+		strip_diff_rect(data, stride, fx, fy, size, r);
+		if (x + r->w > width) {
+			x = 0;
+			y += shelf;
+			shelf = 0;
+		}
+		r->sx = x;
+		r->sy = y;
+		x += r->w;
+		if (r->h > shelf) shelf = r->h;
+	}
+
+	cairo_surface_t *trimmed = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, y + shelf);
+	cairo_t *cr = cairo_create(trimmed);
+	cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+	cairo_set_source_surface(cr, strip, 0, 0);
+	cairo_rectangle(cr, 0, 0, size, size);
+	cairo_fill(cr);
+	for (int i = 0; i < layout->frames; i++) {
+		strip_rect *r = &layout->rects[i];
+		if (!r->w) continue;
+		int fx, fy;
+		strip_meta_frame(layout, i, &fx, &fy);
+		cairo_set_source_surface(cr, strip, r->sx - fx - r->x, r->sy - fy - r->y);
+		cairo_rectangle(cr, r->sx, r->sy, r->w, r->h);
+		cairo_fill(cr);
+	}
+	cairo_destroy(cr);
+	layout->trimmed = 1;
+	return trimmed;
+}
+
+/** save the rendered image to name.png, name.qoi, name.frames and name.h/.c,
+ *  when the formats include them, and the layout to name.meta, trim it first when asked for **/
+static inline int strip_save(cairo_surface_t *knob_img, strip_meta *layout,
+					  const strip_options *o, const char *name) {
+	char png_file[512];
+	char qoi_file[512];
+	char frames_file[512];
+	char meta_file[512];
+	snprintf(png_file, sizeof(png_file), "%s.png", name);
+	snprintf(qoi_file, sizeof(qoi_file), "%s.qoi", name);
+	snprintf(frames_file, sizeof(frames_file), "%s.frames", name);
+	snprintf(meta_file, sizeof(meta_file), "%s.meta", name);
+
+	int ret = 0;
+	cairo_surface_flush(knob_img);
+	cairo_surface_t *img = o->trim ? strip_trim(knob_img, layout) : cairo_surface_reference(knob_img);
+	// the raster writers need the pixels, so draw the svg recording to a image
+	if ((o->formats & STRIP_RASTER) && cairo_surface_get_type(img) != CAIRO_SURFACE_TYPE_IMAGE) {
+		cairo_surface_t *image = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+									layout->size * layout->columns, layout->size * layout->rows);
+		cairo_t *cr = cairo_create(image);
+		cairo_set_source_surface(cr, img, 0, 0);
+		cairo_paint(cr);
+		cairo_destroy(cr);
+		cairo_surface_flush(image);
+		cairo_surface_destroy(img);
+		img = image;
+	}
+	if ((o->formats & STRIP_PNG) && o->colors) {
+		/** one palette for all frames, the error get diffused inside each frame **/
+		int width = cairo_image_surface_get_width(img);
+		int height = cairo_image_surface_get_height(img);
+		uint8_t *indices = (uint8_t*)malloc((size_t)width * height);
+		index_palette pal;
+		uint8_t palette[1024];
+		if (!indices || strip_quantize(cairo_image_surface_get_data(img), width, height,
+				cairo_image_surface_get_stride(img), layout->size, o->colors, o->dither, indices, &pal)) {
+			fprintf(stderr, "could not quantize %s, out of memory\n", png_file);
+			ret = 1;
+		} else {
+			png_unpremultiply_row(pal.palette, palette, pal.colors);
+			if (strip_png_write_indexed(indices, width, height, palette, pal.colors, png_file,
+										o->zlevel >= 0 ? o->zlevel : Z_DEFAULT_COMPRESSION, o->threads)) {
+				fprintf(stderr, "could not write %s\n", png_file);
+				ret = 1;
+			}
+		}
+		free(indices);
+	} else if ((o->formats & STRIP_PNG) && o->zlevel >= 0) {
+		/** the chunked writer, deflated on all -j threads **/
+		if (strip_png_write(cairo_image_surface_get_data(img), cairo_image_surface_get_width(img),
+							cairo_image_surface_get_height(img), cairo_image_surface_get_stride(img),
+							png_file, o->zlevel, o->threads)) {
+			fprintf(stderr, "could not write %s\n", png_file);
+			ret = 1;
+		}
+	} else if (o->formats & STRIP_PNG) {
+		double t = trace_begin();
+		cairo_status_t status = cairo_surface_write_to_png(img, png_file);
+		trace_end("cairo_surface_write_to_png", t);
+		if (status != CAIRO_STATUS_SUCCESS) {
+			fprintf(stderr, "could not write %s: %s\n", png_file, cairo_status_to_string(status));
+			ret = 1;
+		}
+	}
+	if ((o->formats & STRIP_QOI) &&
+			strip_qoi_write(cairo_image_surface_get_data(img), cairo_image_surface_get_width(img),
+							cairo_image_surface_get_height(img), cairo_image_surface_get_stride(img), qoi_file)) {
+		fprintf(stderr, "could not write %s\n", qoi_file);
+		ret = 1;
+	}
+	/** the container and the C arrays hold whole frames, so they are written from
+	 *  the untrimmed strip, trim don't work with svg, then knob_img is a image already **/
+	cairo_surface_t *full = o->trim ? knob_img : img;
+	if (o->formats & STRIP_FRAMES) {
+		if (strip_frames_write(cairo_image_surface_get_data(full), cairo_image_surface_get_stride(full),
+							   layout, o->zlevel, frames_file)) {
+			fprintf(stderr, "could not write %s\n", frames_file);
+			ret = 1;
+		}
+	}
+	if ((o->formats & STRIP_C) &&
+			strip_carray_write(cairo_image_surface_get_data(full), cairo_image_surface_get_stride(full), layout, name)) {
+		fprintf(stderr, "could not write %s.h and %s.c\n", name, name);
+		ret = 1;
+	}
+	if (strip_meta_write(meta_file, layout)) {
+		fprintf(stderr, "could not write %s\n", meta_file);
+		ret = 1;
+	}
+	cairo_surface_destroy(img);
+	return ret;
+}
+
+// raster strips are image surfaces, which can't be larger then this
+static inline int strip_check_size(const strip_meta *layout, const strip_options *o, const char *name) {
+	long width = (long)layout->size * layout->columns;
+	long height = (long)layout->size * layout->rows;
+	if ((o->formats & STRIP_RASTER) && (width > 32767 || height > 32767)) {
+		fprintf(stderr, "%s: %lix%li is above the 32767 px surface limit, use -c to lay out the frames in rows\n",
+				name, width, height);
+		return 1;
+	}
+	return 0;
+}
+
+/** hidpi output, render the strip once at the largest scale and
+ *  downsample it to the others. The scale 1 strip is name.png,
+ *  the others get the scale appended, like name@2x.png **/
+static inline int strip_write_scales(paint_func paint, int knob_size, int knob_frames, int knob_offset,
+							  const strip_options *o, const char *name) {
+	if (o->formats & STRIP_SVG) {
+		fprintf(stderr, "%s: -x needs -f png, qoi, frames or c\n", name);
+		return 1;
+	}
+	double top = 0.0;
+	for (int i = 0; i < o->nscales; i++)
+		if (o->scales[i] > top) top = o->scales[i];
+
+	strip_meta big;
+	strip_meta_init(&big, (int)(knob_size * top + 0.5), knob_frames);
+	strip_meta_layout(&big, o->columns);
+	if (big.size < 1 || strip_check_size(&big, o, name)) return 1;
+	cairo_surface_t *big_img = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+									big.size * big.columns, big.size * big.rows);
+	if (cairo_surface_status(big_img) != CAIRO_STATUS_SUCCESS) {
+		fprintf(stderr, "%s: could not create the %i px strip\n", name, big.size);
+		cairo_surface_destroy(big_img);
+		return 1;
+	}
+	cairo_t *cr = cairo_create(big_img);
+	double start = strip_now();
+	strip_render_scaled(cr, paint, &big, knob_size, knob_offset, top, o);
+	cairo_destroy(cr);
+	cairo_surface_flush(big_img);
+	fprintf(stdout, "%s: rendered %i px frames in %.1f ms\n", name, big.size, (strip_now() - start) * 1e3);
+
+	int ret = 0;
+	for (int i = 0; i < o->nscales; i++) {
+		double scale = o->scales[i];
+		char scaled_name[512];
+		if (scale == 1.0) snprintf(scaled_name, sizeof(scaled_name), "%s", name);
+		else snprintf(scaled_name, sizeof(scaled_name), "%s@%gx", name, scale);
+
+		int size = (int)(knob_size * scale + 0.5);
+		strip_meta layout;
+		strip_meta_init(&layout, size > 0 ? size : 1, knob_frames);
+		strip_meta_layout(&layout, o->columns);
+		int width = layout.size * layout.columns;
+		int height = layout.size * layout.rows;
+
+		cairo_surface_t *img;
+		start = strip_now();
+		if (layout.size == big.size) {
+			img = cairo_surface_reference(big_img);
+		} else {
+			img = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+			strip_downsample(cairo_image_surface_get_data(big_img), big.size * big.columns, big.size * big.rows,
+							 cairo_image_surface_get_stride(big_img), cairo_image_surface_get_data(img),
+							 width, height, cairo_image_surface_get_stride(img));
+			cairo_surface_mark_dirty(img);
+		}
+		double downsample = strip_now() - start;
+
+		if (o->verify) {
+			cairo_surface_t *native = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+			cr = cairo_create(native);
+			start = strip_now();
+			strip_render_scaled(cr, paint, &layout, knob_size, knob_offset, scale, o);
+			cairo_destroy(cr);
+			cairo_surface_flush(native);
+			double render = strip_now() - start;
+			int max_diff;
+			double psnr = strip_psnr(cairo_image_surface_get_data(img), cairo_image_surface_get_stride(img),
+									 cairo_image_surface_get_data(native), cairo_image_surface_get_stride(native),
+									 width, height, &max_diff);
+			fprintf(stdout, "%s: %i px, downsampled in %.1f ms, native render %.1f ms, psnr %.1f dB, max error %i\n",
+					scaled_name, layout.size, downsample * 1e3, render * 1e3, psnr, max_diff);
+			cairo_surface_destroy(native);
+		} else {
+			fprintf(stdout, "%s: %i px, downsampled in %.1f ms\n", scaled_name, layout.size, downsample * 1e3);
+		}
+
+		if (strip_save(img, &layout, o, scaled_name)) ret = 1;
+		cairo_surface_destroy(img);
+		strip_meta_free(&layout);
+	}
+	cairo_surface_destroy(big_img);
+	return ret;
+}
+
+/** render a complete strip and save it to name.png and/or name.svg,
+ *  depending on the formats, and the layout to name.meta, returns 0 on success **/
+static inline int strip_write_strip(paint_func paint, int knob_size, int knob_frames, int knob_offset,
+							 const strip_options *o, const char *name) {
+	if (o->nscales) return strip_write_scales(paint, knob_size, knob_frames, knob_offset, o, name);
+
+	char svg_file[512];
+	snprintf(svg_file, sizeof(svg_file), "%s.svg", name);
+
+	if (o->trim && (o->formats & STRIP_SVG)) {
+		fprintf(stderr, "%s: trimmed frames need -f png, qoi, frames or c\n", name);
+		return 1;
+	}
+
+	strip_meta layout;
+	strip_meta_init(&layout, knob_size, knob_frames);
+	strip_meta_layout(&layout, o->columns);
+	if (strip_check_size(&layout, o, name)) return 1;
+	long width = (long)knob_size * layout.columns;
+	long height = (long)knob_size * layout.rows;
+
+	cairo_surface_t *knob_img = strip_surface(svg_file, width, height, o->formats);
+	if (cairo_surface_status(knob_img) != CAIRO_STATUS_SUCCESS) {
+		fprintf(stderr, "could not create %lix%li strip: %s\n", width, height,
+				cairo_status_to_string(cairo_surface_status(knob_img)));
+		cairo_surface_destroy(knob_img);
+		return 1;
+	}
+	cairo_t *cr = cairo_create(knob_img);
+
+	/** draw the knob per frame to image **/
+	strip_render(cr, paint, &layout, knob_offset, o);
+
+	/** save to png file **/
+	double t = trace_begin();
+	int ret = strip_save(knob_img, &layout, o, name);
+	trace_end("save", t);
+
+	/** clean up, the svg file is written on destroy **/
+	cairo_destroy(cr);
+	cairo_surface_destroy(knob_img);
+	strip_meta_free(&layout);
+	return ret;
+}
+
+// the cache key for a strip, everything which change the output files, but not -j or -v
+static inline uint64_t strip_cache_key(const char *style, int knob_size, int knob_frames, int knob_offset,
+								const strip_options *o) {
+	uint64_t h = strip_cache_key_init();
+	h = cache_hash_str(h, cairo_version_string());
+	h = cache_hash_str(h, style);
+	h = cache_hash_int(h, knob_size);
+	h = cache_hash_int(h, knob_frames);
+	h = cache_hash_int(h, knob_offset);
+	h = cache_hash_int(h, o->formats);
+	h = cache_hash_int(h, o->columns);
+	h = cache_hash_int(h, o->trim);
+	h = cache_hash_int(h, o->nscales);
+	h = cache_hash(h, o->scales, o->nscales * sizeof(double));
+	h = cache_hash_int(h, o->zlevel);
+	h = cache_hash_int(h, o->colors);
+	h = cache_hash_int(h, o->dither);
+	return h;
+}
+
+// check that all files of a strip are there, one name per scale with -x
+static inline int strip_outputs_exist(const strip_options *o, const char *name) {
+	static const struct { int format; const char *ext; } outputs[] = {
+		{STRIP_PNG, "png"}, {STRIP_SVG, "svg"}, {STRIP_QOI, "qoi"},
+		{STRIP_FRAMES, "frames"}, {STRIP_C, "h"}, {STRIP_C, "c"}, {0, "meta"},
+	};
+	int n = o->nscales ? o->nscales : 1;
+	for (int i = 0; i < n; i++) {
+		char scaled_name[512];
+		if (!o->nscales || o->scales[i] == 1.0) snprintf(scaled_name, sizeof(scaled_name), "%s", name);
+		else snprintf(scaled_name, sizeof(scaled_name), "%s@%gx", name, o->scales[i]);
+		for (size_t k = 0; k < sizeof(outputs) / sizeof(outputs[0]); k++) {
+			// format 0, the meta file is always written
+			if (outputs[k].format && !(o->formats & outputs[k].format)) continue;
+			char file[530];
+			snprintf(file, sizeof(file), "%s.%s", scaled_name, outputs[k].ext);
+			if (access(file, R_OK)) return 0;
+		}
+	}
+	return 1;
+}
+
+/** render a strip like strip_write_strip(), with -k only when the key of it
+ *  don't match name.stamp or a output file is missing, style name the paint func **/
+static inline int strip_write(const char *style, paint_func paint, int knob_size, int knob_frames, int knob_offset,
+					   const strip_options *o, const char *name) {
+	if (!o->cache) return strip_write_strip(paint, knob_size, knob_frames, knob_offset, o, name);
+
+	uint64_t key = strip_cache_key(style, knob_size, knob_frames, knob_offset, o);
+	if (strip_cache_match(name, key) && strip_outputs_exist(o, name)) {
+		strip_cache.hits++;
+		fprintf(stdout, "%s: up to date\n", name);
+		return 0;
+	}
+	strip_cache.misses++;
+	strip_cache_drop(name);
+	int ret = strip_write_strip(paint, knob_size, knob_frames, knob_offset, o, name);
+	if (!ret && strip_cache_store(name, key))
+		fprintf(stderr, "could not write %s.stamp\n", name);
+	return ret;
+}
+
+#endif //STRIP_H
@@ -0,0 +1,103 @@
+#ifndef STRIP_CACHE_H
+#define STRIP_CACHE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/** build cache, a strip is only rendered again when its key changed.
+ *  The key is a hash over everything which goes into the output, it is
+ *  kept in name.stamp next to the output files. Bump STRIP_VERSION when the
+ *  output change without a change of the drawing code, like a new file layout.
+ *  The running binary is hashed as well, so a rebuild with changed drawing code
+ *  miss the cache on its own **/
+
+#define STRIP_VERSION "knobmake strip 1"
+
+typedef struct {
+	int hits;
+	int misses;
+} strip_cache_stats;
+
+static strip_cache_stats strip_cache = {0, 0};
+
+// 64 bit FNV-1a
+#define CACHE_FNV_BASIS 0xcbf29ce484222325ULL
+#define CACHE_FNV_PRIME 0x100000001b3ULL
+
+static inline uint64_t cache_hash(uint64_t h, const void *data, size_t len) {
+	const unsigned char *p = (const unsigned char*)data;
+	for (size_t i = 0; i < len; i++) {
+		h ^= p[i];
+		h *= CACHE_FNV_PRIME;
+	}
+	return h;
+}
+
+static inline uint64_t cache_hash_str(uint64_t h, const char *s) {
+	// with the 0, so "ab" "c" don't hash like "a" "bc"
+	return cache_hash(h, s, strlen(s) + 1);
+}
+
+static inline uint64_t cache_hash_int(uint64_t h, int v) {
+	return cache_hash(h, &v, sizeof(v));
+}
+
+// hash of the running binary, read once per run, 0 when it can't be read
+static inline uint64_t cache_exe_hash() {
+	static uint64_t exe_hash = 0;
+	static int done = 0;
+	if (done) return exe_hash;
+	done = 1;
+	FILE *fp = fopen("/proc/self/exe", "rb");
+	if (!fp) return 0;
+	unsigned char buf[65536];
+	size_t n;
+	uint64_t h = CACHE_FNV_BASIS;
+	while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) h = cache_hash(h, buf, n);
+	fclose(fp);
+	exe_hash = h;
+	return exe_hash;
+}
+
+// a key starts with the generator version and the binary
+static inline uint64_t strip_cache_key_init() {
+	uint64_t h = cache_hash_str(CACHE_FNV_BASIS, STRIP_VERSION);
+	uint64_t exe = cache_exe_hash();
+	return cache_hash(h, &exe, sizeof(exe));
+}
+
+// returns 1 when name.stamp hold key
+static inline int strip_cache_match(const char *name, uint64_t key) {
+	char stamp_file[512];
+	snprintf(stamp_file, sizeof(stamp_file), "%s.stamp", name);
+	FILE *fp = fopen(stamp_file, "r");
+	if (!fp) return 0;
+	unsigned long long stored;
+	int match = fscanf(fp, "knobmake cache %llx", &stored) == 1 && stored == key;
+	fclose(fp);
+	return match;
+}
+
+static inline int strip_cache_store(const char *name, uint64_t key) {
+	char stamp_file[512];
+	snprintf(stamp_file, sizeof(stamp_file), "%s.stamp", name);
+	FILE *fp = fopen(stamp_file, "w");
+	if (!fp) return 1;
+	fprintf(fp, "knobmake cache %016llx\n", (unsigned long long)key);
+	return fclose(fp) != 0;
+}
+
+// remove the stamp before rendering, a failed run should not leave a valid one
+static inline void strip_cache_drop(const char *name) {
+	char stamp_file[512];
+	snprintf(stamp_file, sizeof(stamp_file), "%s.stamp", name);
+	unlink(stamp_file);
+}
+
+static inline void strip_cache_report() {
+	fprintf(stdout, "cache: %i hits, %i misses\n", strip_cache.hits, strip_cache.misses);
+}
+
+#endif //STRIP_CACHE_H
@@ -0,0 +1,137 @@
+#ifndef STRIP_CARRAY_H
+#define STRIP_CARRAY_H
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "strip_meta.h"
+#include "strip_rle.h"
+
+/** write a strip as C source, name.h declare the arrays and the size,
+ *  name.c hold the run length encoded frames, see strip_rle.h for the
+ *  format and the decoder **/
+
+// runs shorter then this are cheaper as literal
+#define RLE_MIN_RUN 3
+
+/** encode the size x size frame at data to out, out need room for
+ *  2 * size * size words, returns the number of words **/
+static inline size_t rle_encode_frame(const unsigned char *data, int stride, int size, uint32_t *out) {
+	size_t n = 0;
+	size_t pixels = (size_t)size * size;
+	// the frame as one row, runs go on over the row ends
+	#define RLE_PIXEL(i) (((const uint32_t*)(data + (size_t)((i) / size) * stride))[(i) % size])
+	// the token of the open literal, -1 when there is none
+	long literal = -1;
+	size_t i = 0;
+	while (i < pixels) {
+		uint32_t pixel = RLE_PIXEL(i);
+		size_t run = 1;
+		while (i + run < pixels && run < 0x7fffffff && RLE_PIXEL(i + run) == pixel) run++;
+		if (run >= RLE_MIN_RUN) {
+			out[n++] = STRIP_RLE_RUN | (uint32_t)run;
+			out[n++] = pixel;
+			literal = -1;
+		} else {
+			// start a literal or add to the open one
+			if (literal < 0) {
+				literal = n++;
+				out[literal] = 0;
+			}
+			for (size_t k = 0; k < run; k++) out[n++] = pixel;
+			out[literal] += run;
+		}
+		i += run;
+	}
+	#undef RLE_PIXEL
+	return n;
+}
+
+/** the C identifier for name, the file name without path, all
+ *  other chars then letters and digits become _, upper case for the macros **/
+static inline void carray_ident(const char *name, char *ident, size_t len, int upper) {
+	const char *base = strrchr(name, '/');
+	base = base ? base + 1 : name;
+	size_t i = 0;
+	if (isdigit((unsigned char)*base) && i + 1 < len) ident[i++] = '_';
+	for (; *base && i + 1 < len; base++)
+		ident[i++] = isalnum((unsigned char)*base) ? (upper ? toupper((unsigned char)*base) : *base) : '_';
+	ident[i] = 0;
+}
+
+static inline void carray_words(FILE *fp, const uint32_t *w, size_t n) {
+	for (size_t i = 0; i < n; i++)
+		fprintf(fp, "%s0x%08x,%s", (i % 8) ? " " : "\t", w[i], (i % 8 == 7 || i == n - 1) ? "\n" : "");
+}
+
+/** write the frames of the ARGB32 strip image, at the places given in layout,
+ *  to name.h and name.c, returns 0 on success **/
+static inline int strip_carray_write(const unsigned char *data, int stride, const strip_meta *layout, const char *name) {
+	int size = layout->size;
+	size_t max_words = (size_t)size * size * 2;
+	uint32_t *words = NULL;
+	uint32_t *offsets = (uint32_t*)malloc(((size_t)layout->frames + 1) * sizeof(uint32_t));
+	size_t count = 0;
+	size_t space = 0;
+	for (int i = 0; i < layout->frames; i++) {
+		if (count + max_words > space) {
+			space = (count + max_words) * 2;
+			words = (uint32_t*)realloc(words, space * sizeof(uint32_t));
+		}
+		int fx, fy;
+		strip_meta_frame(layout, i, &fx, &fy);
+		offsets[i] = count;
+		count += rle_encode_frame(data + (size_t)fy * stride + (size_t)fx * 4, stride, size, words + count);
+	}
+	offsets[layout->frames] = count;
+
+	char ident[128];
+	char macro[128];
+	char h_file[512];
+	char c_file[512];
+	carray_ident(name, ident, sizeof(ident), 0);
+	carray_ident(name, macro, sizeof(macro), 1);
+	snprintf(h_file, sizeof(h_file), "%s.h", name);
+	snprintf(c_file, sizeof(c_file), "%s.c", name);
+	const char *h_base = strrchr(h_file, '/');
+	h_base = h_base ? h_base + 1 : h_file;
+
+	int ret = 0;
+	FILE *fp = fopen(h_file, "w");
+	if (fp) {
+		fprintf(fp, "#ifndef %s_H\n#define %s_H\n\n#include <stdint.h>\n\n", macro, macro);
+		fprintf(fp, "/** generated by knobmake, premultiplied ARGB32 frames, run length encoded,\n"
+					" *  expand a frame with strip_rle_frame(%s_data, %s_offsets, frame, ...) from strip_rle.h **/\n\n",
+				ident, ident);
+		fprintf(fp, "#define %s_WIDTH %i\n", macro, size);
+		fprintf(fp, "#define %s_HEIGHT %i\n", macro, size);
+		fprintf(fp, "#define %s_FRAMES %i\n\n", macro, layout->frames);
+		fprintf(fp, "extern const uint32_t %s_data[%zu];\n", ident, count);
+		fprintf(fp, "extern const uint32_t %s_offsets[%i];\n\n", ident, layout->frames + 1);
+		fprintf(fp, "#endif //%s_H\n", macro);
+		ret |= fclose(fp) != 0;
+	} else {
+		ret = 1;
+	}
+
+	fp = ret ? NULL : fopen(c_file, "w");
+	if (fp) {
+		fprintf(fp, "#include \"%s\"\n\n", h_base);
+		fprintf(fp, "const uint32_t %s_offsets[%i] = {\n", ident, layout->frames + 1);
+		carray_words(fp, offsets, layout->frames + 1);
+		fprintf(fp, "};\n\nconst uint32_t %s_data[%zu] = {\n", ident, count);
+		carray_words(fp, words, count);
+		fprintf(fp, "};\n");
+		ret |= fclose(fp) != 0;
+	} else {
+		ret = 1;
+	}
+	free(words);
+	free(offsets);
+	return ret;
+}
+
+#endif //STRIP_CARRAY_H
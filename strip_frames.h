@@ -0,0 +1,206 @@
+#ifndef STRIP_FRAMES_H
+#define STRIP_FRAMES_H
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "strip_meta.h"
+
+/** the .frames container, made to be mapped into memory. It holds the frames
+ *  one after the other as premultiplied ARGB32 in cairo's stride layout,
+ *  so a frame can be wrapped with cairo_image_surface_create_for_data()
+ *  without a copy. Frames could be deflated, then only the frames in use
+ *  need to be inflated. All numbers are little endian.
+ *
+ *  header, 64 byte:  "KNOBFRM1" frames size stride flags, padded with 0
+ *  index:            per frame the offset (64 bit), the stored length and the raw length (32 bit)
+ *  data:             the frames, each at a 64 byte aligned offset **/
+
+#define FRAMES_MAGIC "KNOBFRM1"
+#define FRAMES_HEADER 64
+#define FRAMES_ALIGN 64
+#define FRAMES_DEFLATED 1
+
+static inline void frames_put32(unsigned char *p, uint32_t v) {
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+static inline uint32_t frames_get32(const unsigned char *p) {
+	return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/** write the frames of the ARGB32 strip image, at the places given in layout,
+ *  level < 0 store them raw, else deflate each frame with this level **/
+static inline int strip_frames_write(const unsigned char *data, int stride, const strip_meta *layout,
+							  int level, const char *frames_file) {
+	int size = layout->size;
+	int fstride = size * 4;
+	size_t raw_length = (size_t)fstride * size;
+	FILE *fp = fopen(frames_file, "wb");
+	if (!fp) return 1;
+
+	unsigned char header[FRAMES_HEADER] = {0};
+	memcpy(header, FRAMES_MAGIC, 8);
+	frames_put32(header + 8, layout->frames);
+	frames_put32(header + 12, size);
+	frames_put32(header + 16, fstride);
+	frames_put32(header + 20, level >= 0 ? FRAMES_DEFLATED : 0);
+	int ret = fwrite(header, 1, FRAMES_HEADER, fp) != FRAMES_HEADER;
+
+	// the index is written last, when the lengths are known
+	size_t index_length = (size_t)layout->frames * 16;
+	uint64_t offset = (FRAMES_HEADER + index_length + FRAMES_ALIGN - 1) / FRAMES_ALIGN * FRAMES_ALIGN;
+	unsigned char *index = (unsigned char*)calloc(1, index_length);
+	unsigned char *frame = (unsigned char*)malloc(raw_length);
+	uLongf bound = compressBound(raw_length);
+	unsigned char *packed = (level >= 0) ? (unsigned char*)malloc(bound) : NULL;
+	static const unsigned char zero[FRAMES_ALIGN] = {0};
+
+	for (int i = 0; i < layout->frames && !ret; i++) {
+		int fx, fy;
+		strip_meta_frame(layout, i, &fx, &fy);
+		for (int y = 0; y < size; y++)
+			memcpy(frame + (size_t)y * fstride, data + (size_t)(fy + y) * stride + (size_t)fx * 4, fstride);
+
+		const unsigned char *out = frame;
+		uLongf length = raw_length;
+		if (packed) {
+			length = bound;
+			if (compress2(packed, &length, frame, raw_length, level) != Z_OK) {
+				ret = 1;
+				break;
+			}
+			out = packed;
+		}
+
+		// pad up to the aligned offset of the frame, before the first frame that's the index too
+		long pos = ftell(fp);
+		if (pos < 0 || (uint64_t)pos > offset) {
+			ret = 1;
+			break;
+		}
+		for (uint64_t pad = offset - pos; pad && !ret; ) {
+			size_t n = pad < FRAMES_ALIGN ? pad : FRAMES_ALIGN;
+			ret |= fwrite(zero, 1, n, fp) != n;
+			pad -= n;
+		}
+		ret |= fwrite(out, 1, length, fp) != length;
+
+		unsigned char *e = index + (size_t)i * 16;
+		frames_put32(e, (uint32_t)offset);
+		frames_put32(e + 4, (uint32_t)(offset >> 32));
+		frames_put32(e + 8, length);
+		frames_put32(e + 12, raw_length);
+		offset = (offset + length + FRAMES_ALIGN - 1) / FRAMES_ALIGN * FRAMES_ALIGN;
+	}
+
+	if (!ret) {
+		ret |= fseek(fp, FRAMES_HEADER, SEEK_SET) != 0;
+		ret |= fwrite(index, 1, index_length, fp) != index_length;
+	}
+	ret |= fclose(fp) != 0;
+	free(index);
+	free(frame);
+	free(packed);
+	return ret;
+}
+
+typedef struct {
+	unsigned char *map;
+	size_t map_length;
+	int frames;
+	int size;
+	int stride;
+	int flags;
+	// inflated frames, only used for deflated containers
+	unsigned char **inflated;
+} strip_frames;
+
+// map frames_file, returns non zero when it's not a frames container
+static inline int strip_frames_open(const char *frames_file, strip_frames *f) {
+	memset(f, 0, sizeof(strip_frames));
+	int fd = open(frames_file, O_RDONLY);
+	if (fd < 0) return 1;
+	struct stat st;
+	if (fstat(fd, &st) || st.st_size < FRAMES_HEADER) {
+		close(fd);
+		return 1;
+	}
+	// private and writable, cairo get a non const pointer but never write to a source
+	void *map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) return 1;
+	f->map = (unsigned char*)map;
+	f->map_length = st.st_size;
+	f->frames = frames_get32(f->map + 8);
+	f->size = frames_get32(f->map + 12);
+	f->stride = frames_get32(f->map + 16);
+	f->flags = frames_get32(f->map + 20);
+	// a frame is size rows of stride bytes, so at least size * size * 4
+	uint64_t raw_length = (uint64_t)f->stride * (uint32_t)f->size;
+	if (memcmp(f->map, FRAMES_MAGIC, 8) || f->frames < 1 || f->size < 1 ||
+			(uint64_t)f->stride < (uint64_t)f->size * 4 || raw_length > UINT32_MAX ||
+			FRAMES_HEADER + (uint64_t)f->frames * 16 > f->map_length) {
+		munmap(f->map, f->map_length);
+		f->map = NULL;
+		return 1;
+	}
+	/** check every index entry before a frame is used, the frame need to lie
+	 *  in the file and hold the raw size, raw frames are stored as they are,
+	 *  so there the stored length need to be the raw size too **/
+	for (int i = 0; i < f->frames; i++) {
+		const unsigned char *e = f->map + FRAMES_HEADER + (size_t)i * 16;
+		uint64_t offset = frames_get32(e) | (uint64_t)frames_get32(e + 4) << 32;
+		uint64_t length = frames_get32(e + 8);
+		if (offset > f->map_length || length > f->map_length - offset ||
+				frames_get32(e + 12) != raw_length ||
+				(!(f->flags & FRAMES_DEFLATED) && length != raw_length)) {
+			munmap(f->map, f->map_length);
+			f->map = NULL;
+			return 1;
+		}
+	}
+	if (f->flags & FRAMES_DEFLATED)
+		f->inflated = (unsigned char**)calloc(f->frames, sizeof(unsigned char*));
+	return 0;
+}
+
+// the pixels of frame i, inflated on first use, NULL on error
+static inline unsigned char *strip_frames_get(strip_frames *f, int i) {
+	const unsigned char *e = f->map + FRAMES_HEADER + (size_t)i * 16;
+	uint64_t offset = frames_get32(e) | (uint64_t)frames_get32(e + 4) << 32;
+	if (!(f->flags & FRAMES_DEFLATED)) return f->map + offset;
+	if (f->inflated[i]) return f->inflated[i];
+
+	uLongf length = frames_get32(e + 12);
+	unsigned char *frame = (unsigned char*)malloc(length);
+	// a short frame would be wrapped as a full one, so it need to inflate to the raw length
+	if (!frame || uncompress(frame, &length, f->map + offset, frames_get32(e + 8)) != Z_OK ||
+			length != frames_get32(e + 12)) {
+		free(frame);
+		return NULL;
+	}
+	f->inflated[i] = frame;
+	return frame;
+}
+
+static inline void strip_frames_close(strip_frames *f) {
+	if (f->inflated) {
+		for (int i = 0; i < f->frames; i++) free(f->inflated[i]);
+		free(f->inflated);
+	}
+	if (f->map) munmap(f->map, f->map_length);
+	memset(f, 0, sizeof(strip_frames));
+}
+
+#endif //STRIP_FRAMES_H
@@ -0,0 +1,417 @@
+#ifndef STRIP_INDEX_H
+#define STRIP_INDEX_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+/** indexed strips, the strip is reduced to a palette of up to 256 colors
+ *  with alpha and stored as 8 bit palette png, which take about a quarter
+ *  of the disk space and memory of the ARGB32 strip.
+ *  Colors are handled premultiplied, like cairo keep them, index 0 is
+ *  always the fully transparent color **/
+
+// the histogram and the lookup table use 5 bit per channel
+#define INDEX_KEY(p) ((((p) >> 27) & 0x1f) << 15 | (((p) >> 19) & 0x1f) << 10 | (((p) >> 11) & 0x1f) << 5 | (((p) >> 3) & 0x1f))
+#define INDEX_KEYS (1 << 20)
+
+typedef struct {
+	uint32_t count;
+	uint64_t sum[4];
+	// the channel value the box get sorted by
+	int v;
+} index_color;
+
+typedef struct {
+	int first;
+	int last;
+} index_box;
+
+static inline int index_channel(uint32_t p, int c) {
+	return (p >> (24 - 8 * c)) & 0xff;
+}
+
+static inline int index_compare(const void *a, const void *b) {
+	return ((const index_color*)a)->v - ((const index_color*)b)->v;
+}
+
+// mean of channel c of the color
+static inline int index_mean(const index_color *e, int c) {
+	return (int)((e->sum[c] + e->count / 2) / e->count);
+}
+
+// the channel with the largest range in the box, and the range
+static inline int index_box_range(const index_color *colors, const index_box *b, int *range) {
+	int best = 0;
+	*range = -1;
+	for (int c = 0; c < 4; c++) {
+		int lo = 255, hi = 0;
+		for (int i = b->first; i < b->last; i++) {
+			int m = index_mean(&colors[i], c);
+			if (m < lo) lo = m;
+			if (m > hi) hi = m;
+		}
+		if (hi - lo > *range) {
+			*range = hi - lo;
+			best = c;
+		}
+	}
+	return best;
+}
+
+// squared distance of two premultiplied colors
+static inline int index_distance(uint32_t a, uint32_t b) {
+	int d = 0;
+	for (int c = 0; c < 4; c++) {
+		int e = index_channel(a, c) - index_channel(b, c);
+		d += e * e;
+	}
+	return d;
+}
+
+typedef struct {
+	// premultiplied ARGB32, like cairo
+	uint32_t palette[256];
+	int colors;
+	// nearest palette entry for each 5 bit key, -1 when not looked up yet
+	int16_t *lookup;
+} index_palette;
+
+static inline int index_nearest(index_palette *pal, uint32_t p) {
+	int key = INDEX_KEY(p);
+	if (pal->lookup[key] >= 0) return pal->lookup[key];
+	int best = 0;
+	int best_d = index_distance(p, pal->palette[0]);
+	for (int i = 1; i < pal->colors; i++) {
+		int d = index_distance(p, pal->palette[i]);
+		if (d < best_d) {
+			best_d = d;
+			best = i;
+		}
+	}
+	pal->lookup[key] = best;
+	return best;
+}
+
+/** median cut, split the box with the largest range times pixel count
+ *  at the weighted median until there are colors - 1 boxes,
+ *  returns non zero when out of memory **/
+static inline int index_median_cut(const unsigned char *data, int width, int height, int stride,
+							 int colors, index_palette *pal) {
+	int32_t *slot = (int32_t*)malloc(INDEX_KEYS * sizeof(int32_t));
+	int n = 0, allocated = 1024;
+	index_color *list = (index_color*)malloc(allocated * sizeof(index_color));
+	if (!slot || !list) {
+		free(slot);
+		free(list);
+		return 1;
+	}
+	memset(slot, 0xff, INDEX_KEYS * sizeof(int32_t));
+	for (int y = 0; y < height; y++) {
+		const uint32_t *row = (const uint32_t*)(data + (size_t)y * stride);
+		for (int x = 0; x < width; x++) {
+			uint32_t p = row[x];
+			if (!(p >> 24)) continue;
+			int key = INDEX_KEY(p);
+			if (slot[key] < 0) {
+				if (n == allocated) {
+					index_color *l = (index_color*)realloc(list, allocated * 2 * sizeof(index_color));
+					if (!l) {
+						free(slot);
+						free(list);
+						return 1;
+					}
+					list = l;
+					allocated *= 2;
+				}
+				memset(&list[n], 0, sizeof(index_color));
+				slot[key] = n++;
+			}
+			index_color *e = &list[slot[key]];
+			e->count++;
+			for (int c = 0; c < 4; c++) e->sum[c] += index_channel(p, c);
+		}
+	}
+	free(slot);
+
+	pal->palette[0] = 0;
+	pal->colors = 1;
+	index_box boxes[256];
+	int nboxes = 0;
+	if (n) boxes[nboxes++] = (index_box) {0, n};
+	while (nboxes < colors - 1) {
+		int pick = -1, channel = 0;
+		double score = 0.0;
+		for (int b = 0; b < nboxes; b++) {
+			if (boxes[b].last - boxes[b].first < 2) continue;
+			int range;
+			int c = index_box_range(list, &boxes[b], &range);
+			uint64_t count = 0;
+			for (int i = boxes[b].first; i < boxes[b].last; i++) count += list[i].count;
+			if ((double)range * count > score) {
+				score = (double)range * count;
+				pick = b;
+				channel = c;
+			}
+		}
+		if (pick < 0) break;
+
+		index_box *b = &boxes[pick];
+		uint64_t total = 0;
+		for (int i = b->first; i < b->last; i++) {
+			list[i].v = index_mean(&list[i], channel);
+			total += list[i].count;
+		}
+		qsort(list + b->first, b->last - b->first, sizeof(index_color), index_compare);
+		uint64_t half = 0;
+		int split = b->first + 1;
+		for (int i = b->first; i < b->last - 1; i++) {
+			half += list[i].count;
+			split = i + 1;
+			if (half * 2 >= total) break;
+		}
+		boxes[nboxes++] = (index_box) {split, b->last};
+		b->last = split;
+	}
+
+	for (int b = 0; b < nboxes; b++) {
+		uint64_t sum[4] = {0, 0, 0, 0}, count = 0;
+		for (int i = boxes[b].first; i < boxes[b].last; i++) {
+			for (int c = 0; c < 4; c++) sum[c] += list[i].sum[c];
+			count += list[i].count;
+		}
+		uint32_t p = 0;
+		for (int c = 0; c < 4; c++) p |= (uint32_t)((sum[c] + count / 2) / count) << (24 - 8 * c);
+		pal->palette[pal->colors++] = p;
+	}
+	free(list);
+	return 0;
+}
+
+static inline uint8_t index_clamp(int v, int hi) {
+	return (v < 0) ? 0 : (v > hi) ? hi : v;
+}
+
+/** quantize the ARGB32 image to colors colors, frames are size x size tiles,
+ *  with dither the error get diffused (Floyd-Steinberg) inside each tile,
+ *  indices get width * height bytes, returns non zero when out of memory **/
+static inline int strip_quantize(const unsigned char *data, int width, int height, int stride, int size,
+						   int colors, int dither, uint8_t *indices, index_palette *pal) {
+	if (colors > 256) colors = 256;
+	if (colors < 2) colors = 2;
+	pal->lookup = NULL;
+	if (index_median_cut(data, width, height, stride, colors, pal)) return 1;
+	pal->lookup = (int16_t*)malloc(INDEX_KEYS * sizeof(int16_t));
+	if (!pal->lookup) return 1;
+	memset(pal->lookup, 0xff, INDEX_KEYS * sizeof(int16_t));
+
+	if (!dither) {
+		for (int y = 0; y < height; y++) {
+			const uint32_t *row = (const uint32_t*)(data + (size_t)y * stride);
+			for (int x = 0; x < width; x++)
+				indices[(size_t)y * width + x] = (row[x] >> 24) ? index_nearest(pal, row[x]) : 0;
+		}
+	} else {
+		// error of the current and the next row, with a pixel border left and right
+		int *err = (int*)calloc((size_t)(size + 2) * 8, sizeof(int));
+		if (!err) {
+			free(pal->lookup);
+			pal->lookup = NULL;
+			return 1;
+		}
+		for (int ty = 0; ty < height; ty += size) {
+			for (int tx = 0; tx < width; tx += size) {
+				int tw = (tx + size > width) ? width - tx : size;
+				int th = (ty + size > height) ? height - ty : size;
+				memset(err, 0, (size_t)(size + 2) * 8 * sizeof(int));
+				for (int y = 0; y < th; y++) {
+					int *cur = err + ((y & 1) ? (size + 2) * 4 : 0);
+					int *next = err + ((y & 1) ? 0 : (size + 2) * 4);
+					memset(next, 0, (size_t)(size + 2) * 4 * sizeof(int));
+					const uint32_t *row = (const uint32_t*)(data + (size_t)(ty + y) * stride) + tx;
+					for (int x = 0; x < tw; x++) {
+						uint32_t p = row[x];
+						uint8_t *out = &indices[(size_t)(ty + y) * width + tx + x];
+						// keep the transparent parts clean
+						if (!(p >> 24)) {
+							*out = 0;
+							continue;
+						}
+						int v[4];
+						v[0] = index_clamp(index_channel(p, 0) + cur[(x + 1) * 4] / 16, 255);
+						for (int c = 1; c < 4; c++)
+							v[c] = index_clamp(index_channel(p, c) + cur[(x + 1) * 4 + c] / 16, v[0]);
+						uint32_t q = (uint32_t)v[0] << 24 | v[1] << 16 | v[2] << 8 | v[3];
+						int i = index_nearest(pal, q);
+						*out = i;
+						for (int c = 0; c < 4; c++) {
+							int e = v[c] - index_channel(pal->palette[i], c);
+							cur[(x + 2) * 4 + c] += e * 7;
+							next[x * 4 + c] += e * 3;
+							next[(x + 1) * 4 + c] += e * 5;
+							next[(x + 2) * 4 + c] += e;
+						}
+					}
+				}
+			}
+		}
+		free(err);
+	}
+	free(pal->lookup);
+	pal->lookup = NULL;
+	return 0;
+}
+
+/** a palette png loaded without expanding it,
+ *  the viewer expand only the frames it shows **/
+typedef struct {
+	int width;
+	int height;
+	uint8_t *indices;
+	// premultiplied ARGB32
+	uint32_t palette[256];
+} strip_indexed;
+
+static inline uint32_t index_get32(const unsigned char *p) {
+	return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static inline uint8_t index_multiply(uint8_t a, uint8_t c) {
+	unsigned t = a * c + 0x80;
+	return (t + (t >> 8)) >> 8;
+}
+
+// load a 8 bit palette png, returns non zero when the file is not one
+static inline int strip_indexed_load(const char *png_file, strip_indexed *img) {
+	memset(img, 0, sizeof(strip_indexed));
+	FILE *fp = fopen(png_file, "rb");
+	if (!fp) return 1;
+	unsigned char head[33];
+	static const unsigned char signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+	// the IHDR chunk follow the signature, check it's 8 bit palette, not interlaced
+	if (fread(head, 1, 33, fp) != 33 || memcmp(head, signature, 8) || memcmp(head + 12, "IHDR", 4) ||
+			head[24] != 8 || head[25] != 3 || head[28] != 0) {
+		fclose(fp);
+		return 1;
+	}
+	img->width = index_get32(head + 16);
+	img->height = index_get32(head + 20);
+	if (img->width <= 0 || img->height <= 0) {
+		fclose(fp);
+		return 1;
+	}
+
+	uint8_t rgb[768] = {0};
+	uint8_t alpha[256];
+	memset(alpha, 255, sizeof(alpha));
+	// no chunk can be longer then the file
+	fseek(fp, 0, SEEK_END);
+	long file_len = ftell(fp);
+	fseek(fp, 33, SEEK_SET);
+	size_t raw_len = (size_t)(img->width + 1) * img->height;
+	unsigned char *raw = (unsigned char*)malloc(raw_len);
+	if (!raw || file_len < 0) {
+		free(raw);
+		fclose(fp);
+		return 1;
+	}
+	z_stream zs;
+	memset(&zs, 0, sizeof(zs));
+	inflateInit(&zs);
+	zs.next_out = raw;
+	zs.avail_out = raw_len;
+	int ret = 1;
+	unsigned char len_type[8];
+	while (fread(len_type, 1, 8, fp) == 8) {
+		uint32_t len = index_get32(len_type);
+		// png limit chunks to 2^31 - 1, so len + 4 can't wrap
+		if (len > 0x7fffffff || len > (unsigned long)file_len) break;
+		unsigned char *chunk = (unsigned char*)malloc((size_t)len + 4);
+		if (!chunk || fread(chunk, 1, len + 4, fp) != len + 4) {
+			free(chunk);
+			break;
+		}
+		if (memcmp(len_type + 4, "PLTE", 4) == 0) {
+			memcpy(rgb, chunk, len < 768 ? len : 768);
+		} else if (memcmp(len_type + 4, "tRNS", 4) == 0) {
+			memcpy(alpha, chunk, len < 256 ? len : 256);
+		} else if (memcmp(len_type + 4, "IDAT", 4) == 0) {
+			zs.next_in = chunk;
+			zs.avail_in = len;
+			int z = inflate(&zs, Z_NO_FLUSH);
+			if (z == Z_STREAM_END) ret = 0;
+			else if (z != Z_OK) {
+				free(chunk);
+				break;
+			}
+		} else if (memcmp(len_type + 4, "IEND", 4) == 0) {
+			free(chunk);
+			break;
+		}
+		free(chunk);
+	}
+	inflateEnd(&zs);
+	fclose(fp);
+	if (ret || zs.avail_out) {
+		free(raw);
+		return 1;
+	}
+
+	// undo the filters in place, the previous row is already plain
+	int w = img->width;
+	img->indices = (uint8_t*)malloc((size_t)w * img->height);
+	if (!img->indices) {
+		free(raw);
+		return 1;
+	}
+	for (int y = 0; y < img->height; y++) {
+		unsigned char *f = raw + (size_t)y * (w + 1);
+		uint8_t *row = img->indices + (size_t)y * w;
+		const uint8_t *prev = y ? row - w : NULL;
+		for (int x = 0; x < w; x++) {
+			int a = x ? row[x - 1] : 0;
+			int b = prev ? prev[x] : 0;
+			int c = (prev && x) ? prev[x - 1] : 0;
+			int v = f[x + 1];
+			switch (f[0]) {
+				case 1: v += a; break;
+				case 2: v += b; break;
+				case 3: v += (a + b) / 2; break;
+				case 4: {
+					int p = a + b - c;
+					int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+					v += (pa <= pb && pa <= pc) ? a : (pb <= pc) ? b : c;
+				}
+				break;
+			}
+			row[x] = v;
+		}
+	}
+	free(raw);
+
+	for (int i = 0; i < 256; i++) {
+		uint8_t a = alpha[i];
+		img->palette[i] = (uint32_t)a << 24 | index_multiply(a, rgb[3 * i]) << 16
+						| index_multiply(a, rgb[3 * i + 1]) << 8 | index_multiply(a, rgb[3 * i + 2]);
+	}
+	return 0;
+}
+
+// expand the w x h rectangle at x, y to ARGB32
+static inline void strip_indexed_expand(const strip_indexed *img, int x, int y, int w, int h,
+								 unsigned char *dst, int dstride) {
+	for (int j = 0; j < h; j++) {
+		const uint8_t *src = img->indices + (size_t)(y + j) * img->width + x;
+		uint32_t *d = (uint32_t*)(dst + (size_t)j * dstride);
+		for (int i = 0; i < w; i++) d[i] = img->palette[src[i]];
+	}
+}
+
+static inline void strip_indexed_free(strip_indexed *img) {
+	free(img->indices);
+	img->indices = NULL;
+}
+
+#endif //STRIP_INDEX_H
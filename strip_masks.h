@@ -0,0 +1,187 @@
+#ifndef STRIP_MASKS_H
+#define STRIP_MASKS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "strip_frames.h"
+#include "strip_meta.h"
+
+/** the .masks file of knobmake -m, a strip split into planes, one per color
+ *  role. A coverage plane hold one byte per pixel and get drawn in a color,
+ *  a ARGB32 plane is drawn as it is, in the order they are stored.
+ *  The planes cover the whole strip, laid out like the .meta file says,
+ *  and are deflated one by one, a empty plane is not stored at all.
+ *  All numbers are little endian.
+ *
+ *  header, 64 byte:  "KNOBMSK1" frames size columns rows planes, padded with 0
+ *  per plane 48 byte: name (24 byte, 0 terminated), default color r g b a,
+ *                     bytes per pixel, stored length, raw length, padded with 0
+ *  data:             the deflated planes one after the other **/
+
+#define MASKS_MAGIC "KNOBMSK1"
+#define MASKS_HEADER 64
+#define MASKS_ENTRY 48
+#define MASKS_MAX_PLANES 32
+
+typedef struct {
+	char name[24];
+	// the color the plane is drawn in, not premultiplied, unused for ARGB32 planes
+	unsigned char color[4];
+	// 1 for a coverage plane, 4 for premultiplied ARGB32
+	int bpp;
+	// the pixels, NULL when the plane is empty
+	unsigned char *data;
+	int stride;
+} strip_plane;
+
+typedef struct {
+	strip_meta layout;
+	int planes;
+	strip_plane plane[MASKS_MAX_PLANES];
+	// the planes were read from a file and get freed with it
+	int owned;
+} strip_masks;
+
+static inline int masks_plane_empty(const strip_plane *p, int width, int height) {
+	if (!p->data) return 1;
+	for (int y = 0; y < height; y++) {
+		const unsigned char *row = p->data + (size_t)y * p->stride;
+		for (int x = 0; x < width * p->bpp; x++)
+			if (row[x]) return 0;
+	}
+	return 1;
+}
+
+// level is the zlib level, < 0 for the zlib default
+static inline int strip_masks_write(const strip_masks *m, int level, const char *masks_file) {
+	int width = m->layout.size * m->layout.columns;
+	int height = m->layout.size * m->layout.rows;
+	FILE *fp = fopen(masks_file, "wb");
+	if (!fp) return 1;
+
+	unsigned char header[MASKS_HEADER] = {0};
+	memcpy(header, MASKS_MAGIC, 8);
+	frames_put32(header + 8, m->layout.frames);
+	frames_put32(header + 12, m->layout.size);
+	frames_put32(header + 16, m->layout.columns);
+	frames_put32(header + 20, m->layout.rows);
+	frames_put32(header + 24, m->planes);
+	int ret = fwrite(header, 1, MASKS_HEADER, fp) != MASKS_HEADER;
+
+	// the entries are written last, when the lengths are known
+	size_t entries_length = (size_t)m->planes * MASKS_ENTRY;
+	unsigned char *entries = (unsigned char*)calloc(1, entries_length);
+	ret |= fwrite(entries, 1, entries_length, fp) != entries_length;
+
+	for (int i = 0; i < m->planes && !ret; i++) {
+		const strip_plane *p = &m->plane[i];
+		unsigned char *e = entries + (size_t)i * MASKS_ENTRY;
+		size_t row_length = (size_t)width * p->bpp;
+		uLong raw_length = row_length * height;
+		strncpy((char*)e, p->name, 23);
+		memcpy(e + 24, p->color, 4);
+		frames_put32(e + 28, p->bpp);
+		frames_put32(e + 36, raw_length);
+		if (masks_plane_empty(p, width, height)) continue;
+
+		// deflate row by row, the stride of the plane could be larger then the row
+		z_stream z;
+		memset(&z, 0, sizeof(z));
+		if (deflateInit(&z, level < 0 ? Z_DEFAULT_COMPRESSION : level) != Z_OK) {
+			ret = 1;
+			break;
+		}
+		unsigned char out[65536];
+		uLong stored = 0;
+		for (int y = 0; y < height && !ret; y++) {
+			z.next_in = p->data + (size_t)y * p->stride;
+			z.avail_in = row_length;
+			int flush = (y == height - 1) ? Z_FINISH : Z_NO_FLUSH;
+			int zret;
+			do {
+				z.next_out = out;
+				z.avail_out = sizeof(out);
+				zret = deflate(&z, flush);
+				size_t n = sizeof(out) - z.avail_out;
+				ret |= fwrite(out, 1, n, fp) != n;
+				stored += n;
+			} while (!ret && (z.avail_out == 0 || (flush == Z_FINISH && zret != Z_STREAM_END)));
+		}
+		deflateEnd(&z);
+		frames_put32(e + 32, stored);
+	}
+
+	if (!ret) {
+		ret |= fseek(fp, MASKS_HEADER, SEEK_SET) != 0;
+		ret |= fwrite(entries, 1, entries_length, fp) != entries_length;
+	}
+	ret |= fclose(fp) != 0;
+	free(entries);
+	return ret;
+}
+
+static inline void strip_masks_free(strip_masks *m) {
+	if (m->owned)
+		for (int i = 0; i < m->planes; i++) free(m->plane[i].data);
+	strip_meta_free(&m->layout);
+	memset(m, 0, sizeof(strip_masks));
+}
+
+// read and inflate all planes, returns non zero when it's not a masks file
+static inline int strip_masks_read(const char *masks_file, strip_masks *m) {
+	memset(m, 0, sizeof(strip_masks));
+	FILE *fp = fopen(masks_file, "rb");
+	if (!fp) return 1;
+	unsigned char header[MASKS_HEADER];
+	unsigned char entries[MASKS_MAX_PLANES * MASKS_ENTRY];
+	if (fread(header, 1, MASKS_HEADER, fp) != MASKS_HEADER || memcmp(header, MASKS_MAGIC, 8)) {
+		fclose(fp);
+		return 1;
+	}
+	strip_meta_init(&m->layout, frames_get32(header + 12), frames_get32(header + 8));
+	m->layout.columns = frames_get32(header + 16);
+	m->layout.rows = frames_get32(header + 20);
+	m->planes = frames_get32(header + 24);
+	m->owned = 1;
+	int width = m->layout.size * m->layout.columns;
+	int height = m->layout.size * m->layout.rows;
+	if (m->layout.frames < 1 || m->layout.size < 1 || m->layout.columns < 1 || m->layout.rows < 1 ||
+			width > 32767 || height > 32767 || m->planes < 1 || m->planes > MASKS_MAX_PLANES ||
+			fread(entries, MASKS_ENTRY, m->planes, fp) != (size_t)m->planes) {
+		fclose(fp);
+		m->planes = 0;
+		return 1;
+	}
+
+	int ret = 0;
+	for (int i = 0; i < m->planes && !ret; i++) {
+		strip_plane *p = &m->plane[i];
+		const unsigned char *e = entries + (size_t)i * MASKS_ENTRY;
+		memcpy(p->name, e, 23);
+		memcpy(p->color, e + 24, 4);
+		p->bpp = frames_get32(e + 28);
+		uLong stored = frames_get32(e + 32);
+		uLongf length = frames_get32(e + 36);
+		if ((p->bpp != 1 && p->bpp != 4) || length != (uLong)width * height * p->bpp) {
+			ret = 1;
+			break;
+		}
+		p->stride = width * p->bpp;
+		if (!stored) continue;
+		unsigned char *packed = (unsigned char*)malloc(stored);
+		p->data = (unsigned char*)malloc(length);
+		if (!packed || !p->data || fread(packed, 1, stored, fp) != stored ||
+				uncompress(p->data, &length, packed, stored) != Z_OK || length != frames_get32(e + 36))
+			ret = 1;
+		free(packed);
+	}
+	fclose(fp);
+	if (ret) strip_masks_free(m);
+	return ret;
+}
+
+#endif //STRIP_MASKS_H
@@ -0,0 +1,142 @@
+#ifndef STRIP_META_H
+#define STRIP_META_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** the .meta file next to a strip describe how the frames are laid out,
+ *  it's a plain text file with one "key value" pair per line **/
+
+// the part of a trimmed frame which differs from the base frame
+typedef struct {
+	// position in the image
+	int sx;
+	int sy;
+	// position in the frame and size
+	int x;
+	int y;
+	int w;
+	int h;
+} strip_rect;
+
+typedef struct {
+	int frames;
+	int size;
+	// frames are stored row by row, columns frames per row
+	int columns;
+	int rows;
+	/** trimmed strips store the full base frame at 0,0,
+	 *  followed by the changed part of each frame, given in rects **/
+	int trimmed;
+	strip_rect *rects;
+} strip_meta;
+
+// the layout of a single row strip
+static inline void strip_meta_init(strip_meta *m, int knob_size, int knob_frames) {
+	m->frames = knob_frames;
+	m->size = knob_size;
+	m->columns = knob_frames;
+	m->rows = 1;
+	m->trimmed = 0;
+	m->rects = NULL;
+}
+
+static inline void strip_meta_free(strip_meta *m) {
+	free(m->rects);
+	m->rects = NULL;
+	m->trimmed = 0;
+}
+
+/** columns < 0 lay out all frames in one row,
+ *  columns == 0 pick the near square grid **/
+static inline void strip_meta_layout(strip_meta *m, int columns) {
+	if (columns < 0 || columns > m->frames) {
+		columns = m->frames;
+	} else if (columns == 0) {
+		columns = 1;
+		while (columns * columns < m->frames) columns++;
+	}
+	m->columns = columns;
+	m->rows = (m->frames + columns - 1) / columns;
+}
+
+// position of frame i in the strip
+static inline void strip_meta_frame(const strip_meta *m, int i, int *x, int *y) {
+	*x = m->size * (i % m->columns);
+	*y = m->size * (i / m->columns);
+}
+
+static inline int strip_meta_write(const char *meta_file, const strip_meta *m) {
+	FILE *fp = fopen(meta_file, "w");
+	if (!fp) return 1;
+	fprintf(fp, "# knobmake strip layout\n");
+	fprintf(fp, "frames %i\n", m->frames);
+	fprintf(fp, "size %i\n", m->size);
+	fprintf(fp, "columns %i\n", m->columns);
+	fprintf(fp, "rows %i\n", m->rows);
+	if (m->trimmed) {
+		fprintf(fp, "trimmed 1\n");
+		fprintf(fp, "# frame index, image x y, frame x y, width height\n");
+		for (int i = 0; i < m->frames; i++) {
+			const strip_rect *r = &m->rects[i];
+			fprintf(fp, "frame %i %i %i %i %i %i %i\n", i, r->sx, r->sy, r->x, r->y, r->w, r->h);
+		}
+	}
+	return fclose(fp) ? 1 : 0;
+}
+
+// read the layout, keys not in the file keep the value they have in m
+static inline int strip_meta_read(const char *meta_file, strip_meta *m) {
+	FILE *fp = fopen(meta_file, "r");
+	if (!fp) return 1;
+	char line[256];
+	char key[32];
+	int value;
+	strip_rect r;
+	int ret = 0;
+	while (fgets(line, sizeof(line), fp)) {
+		if (line[0] == '#' || sscanf(line, "%31s %i", key, &value) != 2) continue;
+		if (strcmp(key, "frames") == 0) m->frames = value;
+		else if (strcmp(key, "size") == 0) m->size = value;
+		else if (strcmp(key, "columns") == 0) m->columns = value;
+		else if (strcmp(key, "rows") == 0) m->rows = value;
+		else if (strcmp(key, "trimmed") == 0) m->trimmed = value;
+		else if (strcmp(key, "frame") == 0) {
+			// the frame table follow the frames line
+			if (!m->rects && m->frames > 0) m->rects = (strip_rect*)calloc(m->frames, sizeof(strip_rect));
+			if (sscanf(line, "%31s %i %i %i %i %i %i %i", key, &value, &r.sx, &r.sy, &r.x, &r.y, &r.w, &r.h) != 8
+					|| !m->rects || value < 0 || value >= m->frames) {
+				ret = 1;
+				break;
+			}
+			m->rects[value] = r;
+		}
+	}
+	fclose(fp);
+	if (m->frames < 1 || m->size < 1 || m->columns < 1) ret = 1;
+	if (m->trimmed && !m->rects) ret = 1;
+	return ret;
+}
+
+/** check the layout against the image it came with, a stale .meta could
+ *  point outside of it. returns non zero when a frame or a trimmed part
+ *  don't lie in the width x height image **/
+static inline int strip_meta_check(const strip_meta *m, int width, int height) {
+	if (m->frames < 1 || m->size < 1 || m->columns < 1 || m->rows < 1 ||
+			(long long)m->columns * m->rows < m->frames ||
+			(long long)m->size * m->columns > width || (long long)m->size * m->rows > height)
+		return 1;
+	if (!m->trimmed) return 0;
+	for (int i = 0; i < m->frames; i++) {
+		const strip_rect *r = &m->rects[i];
+		if (!r->w) continue;
+		if (r->w < 0 || r->h < 0 || r->x < 0 || r->y < 0 || r->sx < 0 || r->sy < 0 ||
+				(long long)r->x + r->w > m->size || (long long)r->y + r->h > m->size ||
+				(long long)r->sx + r->w > width || (long long)r->sy + r->h > height)
+			return 1;
+	}
+	return 0;
+}
+
+#endif //STRIP_META_H
@@ -0,0 +1,288 @@
+#ifndef STRIP_PNG_H
+#define STRIP_PNG_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+/** png writer for large strips, the rows are split into chunks which are
+ *  filtered and deflated on several threads, the chunks end on a sync flush
+ *  so they can be joined to one zlib stream, like pigz does.
+ *  Input is cairo's premultiplied ARGB32 for 8 bit RGBA png's,
+ *  or one byte per pixel for 8 bit palette png's **/
+
+/** raw bytes per chunk, the chunks don't depend on the thread count,
+ *  so the file is the same for any number of threads **/
+#define PNG_CHUNK_BYTES (256 * 1024)
+
+// cairo ARGB32 to straight RGBA, rounded like cairo does it
+static inline void png_unpremultiply_row(const uint32_t *src, unsigned char *dst, int width) {
+	for (int x = 0; x < width; x++) {
+		uint32_t p = src[x];
+		uint8_t a = p >> 24;
+		if (a == 0) {
+			dst[0] = dst[1] = dst[2] = dst[3] = 0;
+		} else {
+			dst[0] = (((p >> 16) & 0xff) * 255 + a / 2) / a;
+			dst[1] = (((p >> 8) & 0xff) * 255 + a / 2) / a;
+			dst[2] = ((p & 0xff) * 255 + a / 2) / a;
+			dst[3] = a;
+		}
+		dst += 4;
+	}
+}
+
+static inline int png_paeth(int a, int b, int c) {
+	int p = a + b - c;
+	int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+	if (pa <= pb && pa <= pc) return a;
+	return (pb <= pc) ? b : c;
+}
+
+/** filter one row, prev is NULL for the first row, out get the filter byte
+ *  and len bytes, the filter with the lowest sum of abs values is used,
+ *  bpp is the number of bytes per pixel **/
+static inline void png_filter_row(const unsigned char *row, const unsigned char *prev, int len, int bpp,
+						   unsigned char *out, unsigned char *tmp) {
+	long best_sum = -1;
+	for (int f = 0; f < 5; f++) {
+		if (f >= 2 && !prev) break;
+		long sum = 0;
+		for (int i = 0; i < len; i++) {
+			int a = (i >= bpp) ? row[i - bpp] : 0;
+			int b = prev ? prev[i] : 0;
+			int c = (prev && i >= bpp) ? prev[i - bpp] : 0;
+			int v = row[i];
+			switch (f) {
+				case 1: v -= a; break;
+				case 2: v -= b; break;
+				case 3: v -= (a + b) / 2; break;
+				case 4: v -= png_paeth(a, b, c); break;
+			}
+			tmp[i] = (unsigned char)v;
+			sum += (tmp[i] < 128) ? tmp[i] : 256 - tmp[i];
+		}
+		if (best_sum < 0 || sum < best_sum) {
+			best_sum = sum;
+			out[0] = f;
+			memcpy(out + 1, tmp, len);
+		}
+	}
+}
+
+typedef struct {
+	int y0;
+	int y1;
+	int last;
+	unsigned char *out;
+	size_t out_len;
+	uLong adler;
+	uLong raw_len;
+} png_chunk;
+
+typedef struct {
+	const unsigned char *data;
+	int stride;
+	int width;
+	// 4 for ARGB32, 1 for palette indices
+	int bpp;
+	int level;
+	png_chunk *chunks;
+	int count;
+	int next;
+	int failed;
+	pthread_mutex_t lock;
+} png_job;
+
+// a row of the image as it goes to the png
+static inline void png_get_row(png_job *job, int y, unsigned char *row) {
+	const unsigned char *src = job->data + (size_t)y * job->stride;
+	if (job->bpp == 4) png_unpremultiply_row((const uint32_t*)src, row, job->width);
+	else memcpy(row, src, job->width);
+}
+
+static inline int png_deflate_chunk(png_job *job, png_chunk *c) {
+	int len = job->width * job->bpp;
+	int rows = c->y1 - c->y0;
+	unsigned char *raw = (unsigned char*)malloc((size_t)(len + 1) * rows);
+	unsigned char *rgba = (unsigned char*)malloc((size_t)len * 2);
+	unsigned char *tmp = (unsigned char*)malloc(len);
+	if (!raw || !rgba || !tmp) {
+		free(raw);
+		free(rgba);
+		free(tmp);
+		return 1;
+	}
+	// the row above the chunk is needed for the filters
+	unsigned char *prev = NULL;
+	if (c->y0 > 0) {
+		prev = rgba + len;
+		png_get_row(job, c->y0 - 1, prev);
+	}
+	for (int y = c->y0; y < c->y1; y++) {
+		unsigned char *row = (prev == rgba) ? rgba + len : rgba;
+		png_get_row(job, y, row);
+		png_filter_row(row, prev, len, job->bpp, raw + (size_t)(y - c->y0) * (len + 1), tmp);
+		prev = row;
+	}
+	free(rgba);
+	free(tmp);
+
+	c->raw_len = (uLong)(len + 1) * rows;
+	c->adler = adler32(adler32(0L, Z_NULL, 0), raw, c->raw_len);
+
+	// raw deflate, the zlib header and the adler32 are written once for all chunks
+	z_stream zs;
+	memset(&zs, 0, sizeof(zs));
+	if (deflateInit2(&zs, job->level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		free(raw);
+		return 1;
+	}
+	size_t bound = deflateBound(&zs, c->raw_len) + 16;
+	c->out = (unsigned char*)malloc(bound);
+	zs.next_in = raw;
+	zs.avail_in = c->raw_len;
+	zs.next_out = c->out;
+	zs.avail_out = bound;
+	int ret = deflate(&zs, c->last ? Z_FINISH : Z_SYNC_FLUSH);
+	c->out_len = bound - zs.avail_out;
+	deflateEnd(&zs);
+	free(raw);
+	return (ret == (c->last ? Z_STREAM_END : Z_OK) && zs.avail_in == 0) ? 0 : 1;
+}
+
+static inline void *png_worker_run(void *arg) {
+	png_job *job = (png_job*)arg;
+	for (;;) {
+		pthread_mutex_lock(&job->lock);
+		int i = job->next++;
+		pthread_mutex_unlock(&job->lock);
+		if (i >= job->count) break;
+		if (png_deflate_chunk(job, &job->chunks[i])) {
+			pthread_mutex_lock(&job->lock);
+			job->failed = 1;
+			pthread_mutex_unlock(&job->lock);
+		}
+	}
+	return NULL;
+}
+
+static inline void png_put32(unsigned char *p, uint32_t v) {
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+static inline int png_write_chunk(FILE *fp, const char *type, const unsigned char *data, size_t len) {
+	unsigned char head[8];
+	png_put32(head, (uint32_t)len);
+	memcpy(head + 4, type, 4);
+	uLong crc = crc32(crc32(0L, Z_NULL, 0), head + 4, 4);
+	if (len) crc = crc32(crc, data, len);
+	unsigned char tail[4];
+	png_put32(tail, (uint32_t)crc);
+	return fwrite(head, 1, 8, fp) != 8 || (len && fwrite(data, 1, len, fp) != len) || fwrite(tail, 1, 4, fp) != 4;
+}
+
+/** deflate the rows and write the png, palette is NULL for RGBA,
+ *  else the colors straight RGBA for a palette png **/
+static inline int png_write(const unsigned char *data, int width, int height, int stride, int bpp,
+					 const uint8_t *palette, int colors, const char *png_file, int level, int threads) {
+	png_job job;
+	job.data = data;
+	job.stride = stride;
+	job.width = width;
+	job.bpp = bpp;
+	job.level = level;
+	int chunk_rows = PNG_CHUNK_BYTES / (width * bpp + 1);
+	if (chunk_rows < 1) chunk_rows = 1;
+	job.count = (height + chunk_rows - 1) / chunk_rows;
+	job.chunks = (png_chunk*)calloc(job.count, sizeof(png_chunk));
+	job.next = 0;
+	job.failed = 0;
+	pthread_mutex_init(&job.lock, NULL);
+	for (int i = 0; i < job.count; i++) {
+		job.chunks[i].y0 = i * chunk_rows;
+		job.chunks[i].y1 = (i == job.count - 1) ? height : (i + 1) * chunk_rows;
+		job.chunks[i].last = (i == job.count - 1);
+	}
+
+	if (threads > job.count) threads = job.count;
+	if (threads < 1) threads = 1;
+	pthread_t workers[threads];
+	int started = 0;
+	for (int t = 1; t < threads; t++) {
+		if (pthread_create(&workers[started], NULL, png_worker_run, &job) != 0) break;
+		started++;
+	}
+	png_worker_run(&job);
+	for (int t = 0; t < started; t++)
+		pthread_join(workers[t], NULL);
+	pthread_mutex_destroy(&job.lock);
+
+	int ret = job.failed;
+	FILE *fp = ret ? NULL : fopen(png_file, "wb");
+	if (fp) {
+		static const unsigned char signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+		unsigned char ihdr[13];
+		png_put32(ihdr, width);
+		png_put32(ihdr + 4, height);
+		ihdr[8] = 8;	// bit depth
+		ihdr[9] = palette ? 3 : 6;	// palette or RGBA
+		ihdr[10] = ihdr[11] = ihdr[12] = 0;
+		ret |= fwrite(signature, 1, 8, fp) != 8;
+		ret |= png_write_chunk(fp, "IHDR", ihdr, 13);
+		if (palette) {
+			unsigned char plte[768];
+			unsigned char trns[256];
+			for (int i = 0; i < colors; i++) {
+				memcpy(plte + 3 * i, palette + 4 * i, 3);
+				trns[i] = palette[4 * i + 3];
+			}
+			ret |= png_write_chunk(fp, "PLTE", plte, 3 * colors);
+			ret |= png_write_chunk(fp, "tRNS", trns, colors);
+		}
+
+		// zlib header, the chunks, and the combined adler32 of all rows
+		unsigned char zhead[2] = {0x78, 0x9c};
+		uLong adler = adler32(0L, Z_NULL, 0);
+		ret |= png_write_chunk(fp, "IDAT", zhead, 2);
+		for (int i = 0; i < job.count; i++) {
+			png_chunk *c = &job.chunks[i];
+			adler = adler32_combine(adler, c->adler, c->raw_len);
+			ret |= png_write_chunk(fp, "IDAT", c->out, c->out_len);
+		}
+		unsigned char ztail[4];
+		png_put32(ztail, (uint32_t)adler);
+		ret |= png_write_chunk(fp, "IDAT", ztail, 4);
+		ret |= png_write_chunk(fp, "IEND", NULL, 0);
+		ret |= fclose(fp) != 0;
+	} else {
+		ret = 1;
+	}
+
+	for (int i = 0; i < job.count; i++)
+		free(job.chunks[i].out);
+	free(job.chunks);
+	return ret;
+}
+
+/** write the ARGB32 image data to png_file with zlib level 0 - 9 on up to
+ *  threads threads, returns 0 on success **/
+static inline int strip_png_write(const unsigned char *data, int width, int height, int stride,
+						   const char *png_file, int level, int threads) {
+	return png_write(data, width, height, stride, 4, NULL, 0, png_file, level, threads);
+}
+
+/** write width x height palette indices as 8 bit palette png,
+ *  palette hold colors straight RGBA entries **/
+static inline int strip_png_write_indexed(const uint8_t *indices, int width, int height, const uint8_t *palette,
+								   int colors, const char *png_file, int level, int threads) {
+	return png_write(indices, width, height, width, 1, palette, colors, png_file, level, threads);
+}
+
+#endif //STRIP_PNG_H
@@ -0,0 +1,210 @@
+#ifndef STRIP_QOI_H
+#define STRIP_QOI_H
+
+#include <cairo.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** QOI, the "quite ok image format", a fast to decode alternative to png
+ *  for development builds, see https://qoiformat.org for the spec.
+ *  Pixels are stored as straight RGBA like in the png **/
+
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF  0x40
+#define QOI_OP_LUMA  0x80
+#define QOI_OP_RUN   0xc0
+#define QOI_OP_RGB   0xfe
+#define QOI_OP_RGBA  0xff
+
+typedef union {
+	struct { uint8_t r, g, b, a; } rgba;
+	uint32_t v;
+} qoi_px;
+
+static inline int qoi_hash(qoi_px p) {
+	return (p.rgba.r * 3 + p.rgba.g * 5 + p.rgba.b * 7 + p.rgba.a * 11) % 64;
+}
+
+static inline void qoi_put32(unsigned char *p, uint32_t v) {
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+static inline uint32_t qoi_get32(const unsigned char *p) {
+	return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+// write the cairo ARGB32 image data to qoi_file, returns 0 on success
+static inline int strip_qoi_write(const unsigned char *data, int width, int height, int stride, const char *qoi_file) {
+	// worst case is 5 bytes per pixel
+	size_t max_size = (size_t)width * height * 5 + 14 + 8;
+	unsigned char *out = (unsigned char*)malloc(max_size);
+	if (!out) return 1;
+	size_t p = 0;
+	memcpy(out, "qoif", 4);
+	qoi_put32(out + 4, width);
+	qoi_put32(out + 8, height);
+	out[12] = 4;	// channels
+	out[13] = 0;	// sRGB with linear alpha
+	p = 14;
+
+	qoi_px index[64];
+	memset(index, 0, sizeof(index));
+	qoi_px prev = {{0, 0, 0, 255}};
+	int run = 0;
+	for (int y = 0; y < height; y++) {
+		const uint32_t *row = (const uint32_t*)(data + (size_t)y * stride);
+		for (int x = 0; x < width; x++) {
+			uint32_t s = row[x];
+			uint8_t a = s >> 24;
+			qoi_px px;
+			if (a == 0) {
+				px.v = 0;
+			} else {
+				px.rgba.r = (((s >> 16) & 0xff) * 255 + a / 2) / a;
+				px.rgba.g = (((s >> 8) & 0xff) * 255 + a / 2) / a;
+				px.rgba.b = ((s & 0xff) * 255 + a / 2) / a;
+				px.rgba.a = a;
+			}
+
+			if (px.v == prev.v) {
+				run++;
+				if (run == 62) {
+					out[p++] = QOI_OP_RUN | (run - 1);
+					run = 0;
+				}
+				continue;
+			}
+			if (run) {
+				out[p++] = QOI_OP_RUN | (run - 1);
+				run = 0;
+			}
+			int h = qoi_hash(px);
+			if (index[h].v == px.v) {
+				out[p++] = QOI_OP_INDEX | h;
+			} else {
+				index[h] = px;
+				if (px.rgba.a == prev.rgba.a) {
+					int8_t vr = px.rgba.r - prev.rgba.r;
+					int8_t vg = px.rgba.g - prev.rgba.g;
+					int8_t vb = px.rgba.b - prev.rgba.b;
+					int8_t vg_r = vr - vg;
+					int8_t vg_b = vb - vg;
+					if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+						out[p++] = QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2);
+					} else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9 && vg_b < 8) {
+						out[p++] = QOI_OP_LUMA | (vg + 32);
+						out[p++] = (vg_r + 8) << 4 | (vg_b + 8);
+					} else {
+						out[p++] = QOI_OP_RGB;
+						out[p++] = px.rgba.r;
+						out[p++] = px.rgba.g;
+						out[p++] = px.rgba.b;
+					}
+				} else {
+					out[p++] = QOI_OP_RGBA;
+					out[p++] = px.rgba.r;
+					out[p++] = px.rgba.g;
+					out[p++] = px.rgba.b;
+					out[p++] = px.rgba.a;
+				}
+			}
+			prev = px;
+		}
+	}
+	if (run) out[p++] = QOI_OP_RUN | (run - 1);
+	static const unsigned char padding[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+	memcpy(out + p, padding, 8);
+	p += 8;
+
+	FILE *fp = fopen(qoi_file, "wb");
+	int ret = !fp || fwrite(out, 1, p, fp) != p;
+	if (fp && fclose(fp)) ret = 1;
+	free(out);
+	return ret;
+}
+
+// load qoi_file into a premultiplied ARGB32 image surface, NULL on error
+static inline cairo_surface_t *strip_qoi_load(const char *qoi_file) {
+	FILE *fp = fopen(qoi_file, "rb");
+	if (!fp) return NULL;
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	unsigned char *in = (size > 22) ? (unsigned char*)malloc(size) : NULL;
+	if (!in || fread(in, 1, size, fp) != (size_t)size || memcmp(in, "qoif", 4)) {
+		free(in);
+		fclose(fp);
+		return NULL;
+	}
+	fclose(fp);
+
+	int width = qoi_get32(in + 4);
+	int height = qoi_get32(in + 8);
+	cairo_surface_t *img = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+	if (width <= 0 || height <= 0 || cairo_surface_status(img) != CAIRO_STATUS_SUCCESS) {
+		cairo_surface_destroy(img);
+		free(in);
+		return NULL;
+	}
+	unsigned char *data = cairo_image_surface_get_data(img);
+	int stride = cairo_image_surface_get_stride(img);
+
+	qoi_px index[64];
+	memset(index, 0, sizeof(index));
+	qoi_px px = {{0, 0, 0, 255}};
+	long p = 14;
+	long end = size - 8;
+	int run = 0;
+	for (int y = 0; y < height; y++) {
+		uint32_t *row = (uint32_t*)(data + (size_t)y * stride);
+		for (int x = 0; x < width; x++) {
+			if (run) {
+				run--;
+			} else if (p < end) {
+				int b1 = in[p++];
+				if (b1 == QOI_OP_RGB) {
+					px.rgba.r = in[p++];
+					px.rgba.g = in[p++];
+					px.rgba.b = in[p++];
+				} else if (b1 == QOI_OP_RGBA) {
+					px.rgba.r = in[p++];
+					px.rgba.g = in[p++];
+					px.rgba.b = in[p++];
+					px.rgba.a = in[p++];
+				} else if ((b1 & 0xc0) == QOI_OP_INDEX) {
+					px = index[b1];
+				} else if ((b1 & 0xc0) == QOI_OP_DIFF) {
+					px.rgba.r += ((b1 >> 4) & 0x03) - 2;
+					px.rgba.g += ((b1 >> 2) & 0x03) - 2;
+					px.rgba.b += (b1 & 0x03) - 2;
+				} else if ((b1 & 0xc0) == QOI_OP_LUMA) {
+					int b2 = in[p++];
+					int vg = (b1 & 0x3f) - 32;
+					px.rgba.r += vg - 8 + ((b2 >> 4) & 0x0f);
+					px.rgba.g += vg;
+					px.rgba.b += vg - 8 + (b2 & 0x0f);
+				} else {
+					run = b1 & 0x3f;
+				}
+				index[qoi_hash(px)] = px;
+			}
+			// premultiply like cairo's png loader
+			uint8_t a = px.rgba.a;
+			unsigned r = px.rgba.r * a + 0x80;
+			unsigned g = px.rgba.g * a + 0x80;
+			unsigned b = px.rgba.b * a + 0x80;
+			row[x] = (uint32_t)a << 24 | ((r + (r >> 8)) >> 8) << 16
+					| ((g + (g >> 8)) >> 8) << 8 | ((b + (b >> 8)) >> 8);
+		}
+	}
+	free(in);
+	cairo_surface_mark_dirty(img);
+	return img;
+}
+
+#endif //STRIP_QOI_H
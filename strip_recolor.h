@@ -0,0 +1,227 @@
+#ifndef STRIP_RECOLOR_H
+#define STRIP_RECOLOR_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "strip_masks.h"
+
+/** build a themed strip from the planes of a .masks file. Each coverage plane
+ *  is drawn in its color with OVER, then the ARGB32 planes on top, rounded
+ *  like cairo (pixman) does it. x86_64 use the SSE2 path, 4 pixels per step,
+ *  most of a coverage plane is 0 and get skipped 4 pixels at a time **/
+
+// x / 255 rounded, exact for 0 . . 255 * 255
+#define RECOLOR_DIV255(x) ((((x) + 128) + (((x) + 128) >> 8)) >> 8)
+
+// premultiplied ARGB32 of a color in the range 0 . . 1
+static inline uint32_t recolor_pixel(const double c[4]) {
+	double a = c[3] < 0.0 ? 0.0 : c[3] > 1.0 ? 1.0 : c[3];
+	uint32_t p = (uint32_t)(a * 255.0 + 0.5) << 24;
+	for (int k = 0; k < 3; k++) {
+		double v = c[k] < 0.0 ? 0.0 : c[k] > 1.0 ? 1.0 : c[k];
+		p |= (uint32_t)(v * a * 255.0 + 0.5) << (16 - 8 * k);
+	}
+	return p;
+}
+
+// d = s + d * (1 - alpha of s), s premultiplied
+static inline uint32_t recolor_over(uint32_t s, uint32_t d) {
+	uint32_t ia = 255 - (s >> 24);
+	uint32_t r = 0;
+	for (int k = 0; k < 32; k += 8) {
+		uint32_t x = ((d >> k) & 0xff) * ia;
+		r |= (((s >> k) & 0xff) + RECOLOR_DIV255(x)) << k;
+	}
+	return r;
+}
+
+// color scaled by the coverage m
+static inline uint32_t recolor_in(uint32_t color, uint32_t m) {
+	uint32_t r = 0;
+	for (int k = 0; k < 32; k += 8) {
+		uint32_t x = ((color >> k) & 0xff) * m;
+		r |= RECOLOR_DIV255(x) << k;
+	}
+	return r;
+}
+
+#ifdef __SSE2__
+static inline __m128i recolor_div255_epi16(__m128i x) {
+	x = _mm_add_epi16(x, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+// s + d * (255 - alpha of s) / 255 for two pixels in 16 bit lanes
+static inline __m128i recolor_over_epi16(__m128i s, __m128i d) {
+	__m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, _MM_SHUFFLE(3,3,3,3)), _MM_SHUFFLE(3,3,3,3));
+	__m128i ia = _mm_sub_epi16(_mm_set1_epi16(255), a);
+	return _mm_add_epi16(s, recolor_div255_epi16(_mm_mullo_epi16(d, ia)));
+}
+#endif
+
+// draw color with the coverage of mask over n pixels of dst
+static inline void recolor_mask_row(uint32_t *dst, const uint8_t *mask, uint32_t color, int n) {
+	int x = 0;
+#ifdef __SSE2__
+	__m128i zero = _mm_setzero_si128();
+	__m128i c = _mm_unpacklo_epi8(_mm_set1_epi32((int)color), zero);
+	for (; x + 4 <= n; x += 4) {
+		uint32_t m4;
+		memcpy(&m4, mask + x, 4);
+		if (!m4) continue;
+		__m128i m = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)m4), zero);
+		m = _mm_unpacklo_epi16(m, m);
+		__m128i m01 = _mm_unpacklo_epi32(m, m);
+		__m128i m23 = _mm_unpackhi_epi32(m, m);
+		__m128i d = _mm_loadu_si128((const __m128i*)(dst + x));
+		__m128i s01 = recolor_div255_epi16(_mm_mullo_epi16(c, m01));
+		__m128i s23 = recolor_div255_epi16(_mm_mullo_epi16(c, m23));
+		__m128i d01 = recolor_over_epi16(s01, _mm_unpacklo_epi8(d, zero));
+		__m128i d23 = recolor_over_epi16(s23, _mm_unpackhi_epi8(d, zero));
+		_mm_storeu_si128((__m128i*)(dst + x), _mm_packus_epi16(d01, d23));
+	}
+#endif
+	for (; x < n; x++)
+		if (mask[x]) dst[x] = recolor_over(recolor_in(color, mask[x]), dst[x]);
+}
+
+// draw the premultiplied src over n pixels of dst
+static inline void recolor_over_row(uint32_t *dst, const uint32_t *src, int n) {
+	int x = 0;
+#ifdef __SSE2__
+	__m128i zero = _mm_setzero_si128();
+	for (; x + 4 <= n; x += 4) {
+		__m128i s = _mm_loadu_si128((const __m128i*)(src + x));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(s, zero)) == 0xffff) continue;
+		__m128i d = _mm_loadu_si128((const __m128i*)(dst + x));
+		__m128i d01 = recolor_over_epi16(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+		__m128i d23 = recolor_over_epi16(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+		_mm_storeu_si128((__m128i*)(dst + x), _mm_packus_epi16(d01, d23));
+	}
+#endif
+	for (; x < n; x++)
+		if (src[x]) dst[x] = recolor_over(src[x], dst[x]);
+}
+
+/** composite all planes to the ARGB32 dst, colors hold the premultiplied
+ *  color per plane. It runs row by row through all planes, so a dst row
+ *  stay in the cache while the planes are drawn on it **/
+static inline void strip_recolor(const strip_masks *m, const uint32_t *colors, unsigned char *dst, int stride) {
+	int width = m->layout.size * m->layout.columns;
+	int height = m->layout.size * m->layout.rows;
+	for (int y = 0; y < height; y++) {
+		uint32_t *row = (uint32_t*)(dst + (size_t)y * stride);
+		memset(row, 0, (size_t)width * 4);
+		for (int i = 0; i < m->planes; i++) {
+			const strip_plane *p = &m->plane[i];
+			if (!p->data) continue;
+			const unsigned char *src = p->data + (size_t)y * p->stride;
+			if (p->bpp == 1) recolor_mask_row(row, src, colors[i], width);
+			else recolor_over_row(row, (const uint32_t*)src, width);
+		}
+	}
+}
+
+/** the palette file, a list of themes, each give new colors to some roles,
+ *  the other roles keep the color they are drawn with in knob_draw.h
+ *
+ *  # comment
+ *  theme blue
+ *  body      0.1 0.1 0.3
+ *  pointer   #ffcc00
+ *  ring_foreground 0.2 0.4 0.9 0.8
+ *
+ *  colors are r g b [a] in the range 0 . . 1 or #rrggbb[aa] **/
+
+typedef struct {
+	char name[64];
+	double color[MASKS_MAX_PLANES][4];
+} strip_theme;
+
+// parse "r g b [a]" or "#rrggbb[aa]", returns 0 on success
+static inline int theme_parse_color(const char *s, double c[4]) {
+	c[3] = 1.0;
+	if (*s == '#') {
+		unsigned v[4] = {0, 0, 0, 255};
+		int n = sscanf(s + 1, "%2x%2x%2x%2x", &v[0], &v[1], &v[2], &v[3]);
+		if (n < 3) return 1;
+		for (int k = 0; k < 4; k++) c[k] = v[k] / 255.0;
+		return 0;
+	}
+	return sscanf(s, "%lf %lf %lf %lf", &c[0], &c[1], &c[2], &c[3]) < 3;
+}
+
+/** read the themes for the planes of m, *themes get malloced,
+ *  returns the number of themes, -1 on error **/
+static inline int strip_themes_read(const char *palette_file, const strip_masks *m, strip_theme **themes) {
+	*themes = NULL;
+	FILE *fp = fopen(palette_file, "r");
+	if (!fp) {
+		fprintf(stderr, "could not open %s\n", palette_file);
+		return -1;
+	}
+	char line[256];
+	char key[64];
+	int count = 0;
+	int lineno = 0;
+	int ret = 0;
+	while (fgets(line, sizeof(line), fp)) {
+		lineno++;
+		char *l = line + strspn(line, " \t");
+		if (*l == '#' || sscanf(l, "%63s", key) != 1) continue;
+		const char *value = l + strlen(key);
+		value += strspn(value, " \t");
+		if (strcmp(key, "theme") == 0) {
+			strip_theme *t = (strip_theme*)realloc(*themes, (count + 1) * sizeof(strip_theme));
+			if (!t || sscanf(value, "%63s", t[count].name) != 1) {
+				if (t) *themes = t;
+				fprintf(stderr, "%s:%i: expected \"theme name\"\n", palette_file, lineno);
+				ret = 1;
+				break;
+			}
+			*themes = t;
+			// start with the colors the knob is drawn with
+			for (int i = 0; i < m->planes; i++)
+				for (int k = 0; k < 4; k++) t[count].color[i][k] = m->plane[i].color[k] / 255.0;
+			count++;
+			continue;
+		}
+		int i = 0;
+		while (i < m->planes && strcmp(m->plane[i].name, key)) i++;
+		if (i == m->planes || m->plane[i].bpp != 1) {
+			fprintf(stderr, "%s:%i: %s is not a color role of the masks\n", palette_file, lineno, key);
+			ret = 1;
+			break;
+		}
+		if (!count) {
+			fprintf(stderr, "%s:%i: colors need a \"theme name\" line before them\n", palette_file, lineno);
+			ret = 1;
+			break;
+		}
+		if (theme_parse_color(value, (*themes)[count - 1].color[i])) {
+			fprintf(stderr, "%s:%i: expected \"%s r g b [a]\" or \"%s #rrggbb[aa]\"\n",
+					palette_file, lineno, key, key);
+			ret = 1;
+			break;
+		}
+	}
+	fclose(fp);
+	if (!ret && !count) {
+		fprintf(stderr, "%s: no themes found\n", palette_file);
+		ret = 1;
+	}
+	if (ret) {
+		free(*themes);
+		*themes = NULL;
+		return -1;
+	}
+	return count;
+}
+
+#endif //STRIP_RECOLOR_H
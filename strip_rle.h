@@ -0,0 +1,56 @@
+#ifndef STRIP_RLE_H
+#define STRIP_RLE_H
+
+#include <stdint.h>
+
+/** decoder for the strips knobmake write with -f c, copy this file to the
+ *  plugin, it don't need anything else. The frames are premultiplied ARGB32
+ *  like cairo use them, each frame is run length encoded on its own, so a
+ *  single frame could be expanded when it is needed.
+ *
+ *  a frame is a list of tokens, each a 32 bit word followed by pixels:
+ *  high bit set:    a run, the next pixel repeat (token & 0x7fffffff) times
+ *  high bit clear:  a literal, token pixels follow as they are
+ *  runs and literals go on over the row ends, from the top left to the bottom right **/
+
+#define STRIP_RLE_RUN 0x80000000u
+
+/** expand frame of a strip to dst, width x height pixels with stride bytes
+ *  per row, offsets hold frames + 1 entries, returns 0 on success
+ *  and 1 when the data don't fit the size **/
+static inline int strip_rle_frame(const uint32_t *data, const uint32_t *offsets, int frame,
+						   int width, int height, uint32_t *dst, int stride) {
+	const uint32_t *p = data + offsets[frame];
+	const uint32_t *end = data + offsets[frame + 1];
+	int x = 0, y = 0;
+	uint32_t *row = dst;
+	while (p < end && y < height) {
+		uint32_t token = *p++;
+		uint32_t count = token & ~STRIP_RLE_RUN;
+		int run = (token & STRIP_RLE_RUN) != 0;
+		if (run && p >= end) return 1;
+		uint32_t pixel = run ? *p++ : 0;
+		while (count) {
+			if (y >= height) return 1;
+			uint32_t n = (uint32_t)(width - x);
+			if (n > count) n = count;
+			if (run) {
+				for (uint32_t i = 0; i < n; i++) row[x + i] = pixel;
+			} else {
+				if ((uint32_t)(end - p) < n) return 1;
+				for (uint32_t i = 0; i < n; i++) row[x + i] = p[i];
+				p += n;
+			}
+			x += n;
+			count -= n;
+			if (x == width) {
+				x = 0;
+				y++;
+				row = (uint32_t*)((uint8_t*)row + stride);
+			}
+		}
+	}
+	return (y == height && p == end) ? 0 : 1;
+}
+
+#endif //STRIP_RLE_H
@@ -0,0 +1,107 @@
+#ifndef STRIP_ROTATE_H
+#define STRIP_ROTATE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** the .rotate file of a rotation strip, knobmake -r. Instead of frames the
+ *  png hold layers side by side: the base, the overlay and the sprites, which
+ *  are drawn at the angle of state 0. The viewer rotate the sprites to the
+ *  angle of the state and draw the indicator ring from the parameters here.
+ *  It's a plain text file with one "key values" line per parameter **/
+
+#define ROTATE_MAX_SPRITES 4
+
+typedef struct {
+	int size;
+	// layers in the png, base, overlay, then the sprites
+	int layers;
+	int sprites;
+	// rotation center of each sprite
+	double sprite_x[ROTATE_MAX_SPRITES];
+	double sprite_y[ROTATE_MAX_SPRITES];
+	// the angle of state 0, the sprites are drawn at it, and the angle for state 0 . . 1
+	double angle;
+	double span;
+	// the indicator ring, drawn above the sprites and below the overlay
+	double ring_x;
+	double ring_y;
+	double ring_radius;
+	double ring_width;
+	double ring_dash[2];
+	// cairo arc angle of state 0, and the length of the background arc
+	double ring_start;
+	double ring_sweep;
+	double ring_background[3];
+	double ring_foreground[3];
+} strip_rotation;
+
+static inline int strip_rotation_write(const char *rotate_file, const strip_rotation *r) {
+	FILE *fp = fopen(rotate_file, "w");
+	if (!fp) return 1;
+	fprintf(fp, "# knobmake rotation layers\n");
+	fprintf(fp, "size %i\n", r->size);
+	fprintf(fp, "layers %i\n", r->layers);
+	fprintf(fp, "# sprite index, rotation center x y\n");
+	for (int i = 0; i < r->sprites; i++)
+		fprintf(fp, "sprite %i %.17g %.17g\n", i, r->sprite_x[i], r->sprite_y[i]);
+	fprintf(fp, "angle %.17g %.17g\n", r->angle, r->span);
+	fprintf(fp, "# ring x y radius width\n");
+	fprintf(fp, "ring %.17g %.17g %.17g %.17g\n", r->ring_x, r->ring_y, r->ring_radius, r->ring_width);
+	fprintf(fp, "ring_dash %.17g %.17g\n", r->ring_dash[0], r->ring_dash[1]);
+	fprintf(fp, "ring_arc %.17g %.17g\n", r->ring_start, r->ring_sweep);
+	fprintf(fp, "ring_background %.17g %.17g %.17g\n",
+			r->ring_background[0], r->ring_background[1], r->ring_background[2]);
+	fprintf(fp, "ring_foreground %.17g %.17g %.17g\n",
+			r->ring_foreground[0], r->ring_foreground[1], r->ring_foreground[2]);
+	return fclose(fp) ? 1 : 0;
+}
+
+// read the rotation parameters, returns non zero when the file is missing or incomplete
+static inline int strip_rotation_read(const char *rotate_file, strip_rotation *r) {
+	memset(r, 0, sizeof(strip_rotation));
+	FILE *fp = fopen(rotate_file, "r");
+	if (!fp) return 1;
+	char line[256];
+	char key[32];
+	double a, b, c, d;
+	int i;
+	int found = 0;
+	int ret = 0;
+	while (fgets(line, sizeof(line), fp)) {
+		if (line[0] == '#' || sscanf(line, "%31s", key) != 1) continue;
+		if (strcmp(key, "size") == 0 && sscanf(line, "%*s %i", &r->size) == 1) found |= 1;
+		else if (strcmp(key, "layers") == 0 && sscanf(line, "%*s %i", &r->layers) == 1) found |= 2;
+		else if (strcmp(key, "sprite") == 0) {
+			if (sscanf(line, "%*s %i %lf %lf", &i, &a, &b) != 3 || i < 0 || i >= ROTATE_MAX_SPRITES) {
+				ret = 1;
+				break;
+			}
+			r->sprite_x[i] = a;
+			r->sprite_y[i] = b;
+			if (i >= r->sprites) r->sprites = i + 1;
+		}
+		else if (strcmp(key, "angle") == 0 && sscanf(line, "%*s %lf %lf", &r->angle, &r->span) == 2) found |= 4;
+		else if (strcmp(key, "ring") == 0 && sscanf(line, "%*s %lf %lf %lf %lf", &a, &b, &c, &d) == 4) {
+			r->ring_x = a;
+			r->ring_y = b;
+			r->ring_radius = c;
+			r->ring_width = d;
+			found |= 8;
+		}
+		else if (strcmp(key, "ring_dash") == 0)
+			sscanf(line, "%*s %lf %lf", &r->ring_dash[0], &r->ring_dash[1]);
+		else if (strcmp(key, "ring_arc") == 0 && sscanf(line, "%*s %lf %lf", &r->ring_start, &r->ring_sweep) == 2)
+			found |= 16;
+		else if (strcmp(key, "ring_background") == 0)
+			sscanf(line, "%*s %lf %lf %lf", &r->ring_background[0], &r->ring_background[1], &r->ring_background[2]);
+		else if (strcmp(key, "ring_foreground") == 0)
+			sscanf(line, "%*s %lf %lf %lf", &r->ring_foreground[0], &r->ring_foreground[1], &r->ring_foreground[2]);
+	}
+	fclose(fp);
+	if (found != 31 || r->size < 1 || r->sprites < 1 || r->layers != 2 + r->sprites) ret = 1;
+	return ret;
+}
+
+#endif //STRIP_ROTATE_H
@@ -0,0 +1,182 @@
+#ifndef STRIP_SCALE_H
+#define STRIP_SCALE_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/** downsample premultiplied ARGB32 by area averaging, each destination pixel
+ *  is the coverage weighted mean of the source pixels below it, so the ratio
+ *  don't need to be a integer. It runs in two passes per destination row,
+ *  first the source rows are added with their weight into a float row, the
+ *  weight is broadcast over 4 pixels per step with SSE2 and 8 with AVX2,
+ *  then the float row is shrunk to the destination width, one pixel per
+ *  step with SSE2 and two with AVX2. x86_64 always use the SSE2 path, build
+ *  with -mavx2 for AVX2. The sums run in the same order on all paths, so
+ *  the result is the same, only faster **/
+
+// the source pixels covering one destination pixel
+typedef struct {
+	int first;
+	int count;
+	float *w;
+} scale_taps;
+
+// taps to shrink src pixels to dst pixels, dst <= src
+static inline scale_taps *scale_taps_create(int src, int dst) {
+	double r = (double)src / dst;
+	int n = (int)ceil(r) + 1;
+	scale_taps *t = (scale_taps*)calloc(dst, sizeof(scale_taps));
+	float *w = (float*)calloc((size_t)dst * n, sizeof(float));
+	for (int i = 0; i < dst; i++) {
+		double s0 = i * r;
+		double s1 = (i + 1) * r;
+		int first = (int)floor(s0);
+		int last = (int)ceil(s1);
+		if (last > src) last = src;
+		t[i].first = first;
+		t[i].count = last - first;
+		t[i].w = w + (size_t)i * n;
+		for (int k = 0; k < t[i].count; k++) {
+			double a = (s0 > first + k) ? s0 : first + k;
+			double b = (s1 < first + k + 1) ? s1 : first + k + 1;
+			t[i].w[k] = (float)((b - a) / r);
+		}
+	}
+	return t;
+}
+
+static inline void scale_taps_free(scale_taps *t) {
+	free(t[0].w);
+	free(t);
+}
+
+// the float row get padded by the taps per pixel, the AVX2 shrink read up to that past the last pixel
+static inline int scale_taps_width(int src, int dst) {
+	return (int)ceil((double)src / dst) + 1;
+}
+
+// add n source pixels with weight w to the float row acc
+static inline void scale_col_add(const uint8_t *src, int n, float w, float *acc) {
+	int x = 0;
+#if defined(__AVX2__)
+	__m256 vw = _mm256_set1_ps(w);
+	for (; x + 8 <= n; x += 8) {
+		for (int k = 0; k < 4; k++) {
+			__m128i p = _mm_loadl_epi64((const __m128i*)(src + 4 * x + 8 * k));
+			__m256 f = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(p));
+			float *a = acc + 4 * x + 8 * k;
+			_mm256_storeu_ps(a, _mm256_add_ps(_mm256_loadu_ps(a), _mm256_mul_ps(f, vw)));
+		}
+	}
+#elif defined(__SSE2__)
+	__m128i zero = _mm_setzero_si128();
+	__m128 vw = _mm_set1_ps(w);
+	for (; x + 4 <= n; x += 4) {
+		__m128i p = _mm_loadu_si128((const __m128i*)(src + 4 * x));
+		__m128i lo = _mm_unpacklo_epi8(p, zero);
+		__m128i hi = _mm_unpackhi_epi8(p, zero);
+		__m128i q[4] = {_mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero),
+						_mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero)};
+		for (int k = 0; k < 4; k++) {
+			float *a = acc + 4 * x + 4 * k;
+			_mm_storeu_ps(a, _mm_add_ps(_mm_loadu_ps(a), _mm_mul_ps(_mm_cvtepi32_ps(q[k]), vw)));
+		}
+	}
+#endif
+	for (int i = 4 * x; i < 4 * n; i++) acc[i] += src[i] * w;
+}
+
+// round a float pixel to ARGB32
+static inline uint32_t scale_pixel_round(const float *p) {
+	uint32_t v = 0;
+	for (int c = 0; c < 4; c++) {
+		long i = lrintf(p[c]);
+		v |= (uint32_t)(i < 0 ? 0 : i > 255 ? 255 : i) << (8 * c);
+	}
+	return v;
+}
+
+// shrink the float row to dw destination pixels
+static inline void scale_row_shrink(const float *acc, const scale_taps *tx, int dw, uint32_t *dst) {
+	int x = 0;
+#if defined(__AVX2__)
+	// two destination pixels per step, the taps are padded with 0 weights
+	for (; x + 2 <= dw; x += 2) {
+		const scale_taps *t0 = &tx[x];
+		const scale_taps *t1 = &tx[x + 1];
+		int count = t0->count > t1->count ? t0->count : t1->count;
+		__m256 sum = _mm256_setzero_ps();
+		for (int k = 0; k < count; k++) {
+			__m256 p = _mm256_set_m128(_mm_loadu_ps(acc + 4 * (t1->first + k)), _mm_loadu_ps(acc + 4 * (t0->first + k)));
+			__m256 w = _mm256_set_m128(_mm_set1_ps(t1->w[k]), _mm_set1_ps(t0->w[k]));
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(p, w));
+		}
+		__m256i i = _mm256_cvtps_epi32(sum);
+		__m128i q = _mm_packs_epi32(_mm256_castsi256_si128(i), _mm256_extracti128_si256(i, 1));
+		_mm_storel_epi64((__m128i*)(dst + x), _mm_packus_epi16(q, q));
+	}
+#endif
+#if defined(__SSE2__)
+	for (; x < dw; x++) {
+		const scale_taps *t = &tx[x];
+		__m128 sum = _mm_setzero_ps();
+		for (int k = 0; k < t->count; k++)
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(acc + 4 * (t->first + k)), _mm_set1_ps(t->w[k])));
+		__m128i q = _mm_packs_epi32(_mm_cvtps_epi32(sum), _mm_setzero_si128());
+		dst[x] = (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(q, q));
+	}
+#endif
+	for (; x < dw; x++) {
+		const scale_taps *t = &tx[x];
+		float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+		for (int k = 0; k < t->count; k++)
+			for (int c = 0; c < 4; c++) sum[c] += acc[4 * (t->first + k) + c] * t->w[k];
+		dst[x] = scale_pixel_round(sum);
+	}
+}
+
+static inline void strip_downsample(const unsigned char *src, int sw, int sh, int sstride,
+							 unsigned char *dst, int dw, int dh, int dstride) {
+	scale_taps *tx = scale_taps_create(sw, dw);
+	scale_taps *ty = scale_taps_create(sh, dh);
+	size_t row = (size_t)(sw + scale_taps_width(sw, dw)) * 4;
+	float *acc = (float*)malloc(row * sizeof(float));
+	for (int y = 0; y < dh; y++) {
+		memset(acc, 0, row * sizeof(float));
+		for (int k = 0; k < ty[y].count; k++)
+			scale_col_add(src + (size_t)(ty[y].first + k) * sstride, sw, ty[y].w[k], acc);
+		scale_row_shrink(acc, tx, dw, (uint32_t*)(dst + (size_t)y * dstride));
+	}
+	free(acc);
+	scale_taps_free(tx);
+	scale_taps_free(ty);
+}
+
+// psnr in dB over all channels of two images of the same size, and the largest difference
+static inline double strip_psnr(const unsigned char *a, int astride, const unsigned char *b, int bstride,
+						 int width, int height, int *max_diff) {
+	double sq = 0.0;
+	*max_diff = 0;
+	for (int y = 0; y < height; y++) {
+		const unsigned char *pa = a + (size_t)y * astride;
+		const unsigned char *pb = b + (size_t)y * bstride;
+		for (int x = 0; x < width * 4; x++) {
+			int d = abs(pa[x] - pb[x]);
+			if (d > *max_diff) *max_diff = d;
+			sq += d * d;
+		}
+	}
+	if (sq == 0.0) return INFINITY;
+	double mse = sq / ((double)width * height * 4);
+	return 10.0 * log10(255.0 * 255.0 / mse);
+}
+
+#endif //STRIP_SCALE_H
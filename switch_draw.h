@@ -0,0 +1,211 @@
+#ifndef SWITCH_DRAW_H
+#define SWITCH_DRAW_H
+
+#include <cairo.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+// the switch drawing, edit this to create a new switch
+
+static inline void rounded_rectangle(cairo_t *cr,double x0, double y0, double x1, double y1) {
+	cairo_new_path (cr);
+	cairo_move_to  (cr, x0, (y0 + y1)/2);
+	cairo_curve_to (cr, x0 ,y0, x0, y0, (x0 + x1)/2, y0);
+	cairo_curve_to (cr, x1, y0, x1, y0, x1, (y0 + y1)/2);
+	cairo_curve_to (cr, x1, y1, x1, y1, (x1 + x0)/2, y1);
+	cairo_curve_to (cr, x0, y1, x0, y1, x0, (y0 + y1)/2);
+	cairo_close_path (cr);
+}
+
+/** the gradients only depend on the size, they are made once
+ *  per size and offset and reused by every frame, like the knob shapes
+ *  at most SWITCH_PATTERNS_MAX sizes are kept, unused ones get dropped **/
+#define SWITCH_PATTERNS_MAX 16
+
+typedef struct switch_patterns {
+	int knob_size;
+	int knob_offset;
+	cairo_pattern_t *pat;
+	cairo_pattern_t *pat2;
+	cairo_pattern_t *pat3;
+	// frames drawing with it, and the last use for the lru order
+	int users;
+	unsigned long used;
+	struct switch_patterns *next;
+} switch_patterns;
+
+static switch_patterns *switch_pattern_cache = NULL;
+static int switch_pattern_count = 0;
+static unsigned long switch_pattern_tick = 0;
+static pthread_mutex_t switch_pattern_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static inline void switch_patterns_free(switch_patterns *p) {
+	cairo_pattern_destroy(p->pat);
+	cairo_pattern_destroy(p->pat2);
+	cairo_pattern_destroy(p->pat3);
+	free(p);
+}
+
+// drop unused patterns, least recent used first, until the cache is down to SWITCH_PATTERNS_MAX
+static inline void switch_patterns_trim() {
+	while (switch_pattern_count > SWITCH_PATTERNS_MAX) {
+		switch_patterns **oldest = NULL;
+		for (switch_patterns **p = &switch_pattern_cache; *p; p = &(*p)->next)
+			if (!(*p)->users && (!oldest || (*p)->used < (*oldest)->used)) oldest = p;
+		if (!oldest) break;
+		switch_patterns *p = *oldest;
+		*oldest = p->next;
+		switch_patterns_free(p);
+		switch_pattern_count--;
+	}
+}
+
+// the patterns stay valid until switch_patterns_release()
+static inline const switch_patterns *switch_patterns_get(int knob_size, int knob_offset) {
+	pthread_mutex_lock(&switch_pattern_lock);
+	switch_patterns *p = switch_pattern_cache;
+	while (p && (p->knob_size != knob_size || p->knob_offset != knob_offset))
+		p = p->next;
+	if (p) {
+		p->users++;
+		p->used = ++switch_pattern_tick;
+		pthread_mutex_unlock(&switch_pattern_lock);
+		return p;
+	}
+
+	double x0      = 5.0;
+	double y0      = 0.0;
+	double rect_width  = knob_size-knob_offset-10.0;
+	double rect_height = knob_size-knob_offset;
+
+	cairo_pattern_t* 	pat = cairo_pattern_create_linear (x0+rect_width/2, y0,x0+rect_width/2,rect_height);
+	cairo_pattern_add_color_stop_rgba (pat, 0,  0.0, 0.0, 0.0, 1.0);
+	cairo_pattern_add_color_stop_rgba (pat, 0.75,  0.15, 0.15, 0.15, 1.0);
+	cairo_pattern_add_color_stop_rgba (pat, 0.5,  0.2, 0.2, 0.2, 1.0);
+	cairo_pattern_add_color_stop_rgba (pat, 0.25,  0.15, 0.15, 0.15, 1.0);
+	cairo_pattern_add_color_stop_rgba (pat, 1,  0.0, 0.0, 0.0, 1.0);
+
+	cairo_pattern_t* 	pat2 = cairo_pattern_create_linear (x0+rect_width/2, y0,x0+rect_width/2,rect_height);
+	cairo_pattern_add_color_stop_rgba (pat2, 1,  0.0, 0.0, 0.0,1.0);
+	cairo_pattern_add_color_stop_rgba (pat2, 0.5,  0.1, 0.1, 0.1, 1.0);
+	cairo_pattern_add_color_stop_rgba (pat2, 0,  0.0, 0.0, 0.0, 1.0);
+
+	cairo_pattern_t*	pat3 = cairo_pattern_create_linear (x0+rect_width/2, y0,x0+rect_width/2,rect_height);
+	cairo_pattern_add_color_stop_rgba (pat3, 0,  0.4, 0.4, 0.4, 1.0);
+	cairo_pattern_add_color_stop_rgba (pat3, 0.45,  0.1, 0.1, 0.1, 1.0);
+	cairo_pattern_add_color_stop_rgba (pat3, 0.5,  0.1, 0.1, 0.1, 1.0);
+	cairo_pattern_add_color_stop_rgba (pat3, 0.55,  0.1, 0.1, 0.1, 1.0);
+	cairo_pattern_add_color_stop_rgba (pat3, 1,  0.4, 0.4, 0.4, 1.0);
+
+	p = (switch_patterns*)calloc(1, sizeof(switch_patterns));
+	p->knob_size = knob_size;
+	p->knob_offset = knob_offset;
+	p->pat = pat;
+	p->pat2 = pat2;
+	p->pat3 = pat3;
+	p->users = 1;
+	p->used = ++switch_pattern_tick;
+	p->next = switch_pattern_cache;
+	switch_pattern_cache = p;
+	switch_pattern_count++;
+	switch_patterns_trim();
+	pthread_mutex_unlock(&switch_pattern_lock);
+	return p;
+}
+
+static inline void switch_patterns_release(const switch_patterns *p) {
+	pthread_mutex_lock(&switch_pattern_lock);
+	((switch_patterns*)p)->users--;
+	pthread_mutex_unlock(&switch_pattern_lock);
+}
+
+// free all patterns, only call it when nothing is drawn, like at exit
+static inline void switch_patterns_clear() {
+	pthread_mutex_lock(&switch_pattern_lock);
+	while (switch_pattern_cache) {
+		switch_patterns *p = switch_pattern_cache;
+		switch_pattern_cache = p->next;
+		switch_patterns_free(p);
+	}
+	switch_pattern_count = 0;
+	pthread_mutex_unlock(&switch_pattern_lock);
+}
+
+static inline void paint_switch_state(cairo_t *cr, int knob_size, int knob_offset, double knobstate)
+{
+
+	// base calculation
+	double x0      = 5.0;
+	double y0      = 0.0;
+	double rect_width  = knob_size-knob_offset-10.0;
+	double rect_height = knob_size-knob_offset;
+	double x1=x0+rect_width;
+	double y1=y0+rect_height;
+
+	// patterns
+	const switch_patterns *p = switch_patterns_get(knob_size, knob_offset);
+	cairo_pattern_t *pat;
+
+	// base
+	rounded_rectangle(cr, x0, y0, x1, y1);
+	cairo_set_source (cr, p->pat);
+	cairo_fill_preserve (cr);
+	cairo_set_source_rgba (cr, 0.1, 0.1, 0.1, 1.0);
+	cairo_set_line_width (cr, 2.0);
+	cairo_stroke (cr);
+
+	// inner frame and switch top
+	x0 = 13.0;
+	y0 = 8.0;
+	x1=x0+rect_width-16.0;
+	y1=y0+rect_height-16.0;
+	rounded_rectangle(cr, x0, y0, x1, y1);
+	cairo_set_source (cr, p->pat3);
+	cairo_fill_preserve (cr);
+	cairo_set_source_rgba (cr, 0.1, 0.1, 0.1, 0.8);
+	cairo_set_line_width (cr, 2.0);
+	cairo_stroke (cr);
+
+	// 3d switch top
+	x0 = 13.0;
+	y0 = 10.0;
+	x1=x0+rect_width-16.0;
+	y1=y0+rect_height-20.0;
+	rounded_rectangle(cr, x0, y0, x1, y1);
+	cairo_set_source (cr, p->pat3);
+	cairo_fill_preserve (cr);
+	cairo_set_source_rgba (cr, 0.1, 0.1, 0.1, 0.8);
+	cairo_set_line_width (cr, 2.0);
+	cairo_stroke (cr);
+
+	// inner and switch base
+	x0 = 15.0;
+	y0 = 10.0 +(rect_height-20.0)*knobstate;
+	x1=x0+rect_width-20.0;
+	y1=y0+(rect_height-20.0)/2;
+	rounded_rectangle(cr, x0, y0, x1, y1);
+	cairo_set_source (cr, p->pat2);
+	cairo_fill(cr);
+
+	// led indicator
+	cairo_new_path (cr);
+	x0 = 5.0+(rect_width/2) -(rect_width/10.0);
+	y0 = 4.0 ;
+	x1= x0 +(rect_width/5.0);
+	y1=y0;
+	cairo_set_line_width (cr, 5.0);
+	cairo_set_line_cap(cr, CAIRO_LINE_CAP_ROUND);
+	cairo_move_to  (cr, x0, y0);
+	cairo_line_to (cr, x1 , y1);
+	pat = cairo_pattern_create_linear (x0, y0,x1,y1);
+	cairo_pattern_add_color_stop_rgba (pat, 1,  0.2 +(0.5*knobstate), 0.1, 0.05,1.0);
+	cairo_pattern_add_color_stop_rgba (pat, 0.5,  0.2 +(0.7*knobstate), 0.05, 0.1, 1.0);
+	cairo_pattern_add_color_stop_rgba (pat, 0,  0.2 +(0.5*knobstate), 0.1, 0.05, 1.0);
+	cairo_set_source (cr, pat);
+	cairo_stroke (cr);
+
+	cairo_pattern_destroy (pat);
+	switch_patterns_release(p);
+}
+
+#endif //SWITCH_DRAW_H